@@ -0,0 +1,47 @@
+#!/bin/sh
+# Generuje nagłówki z obrazami pamięci (computer_image.h). Każdy generator
+# to plik .cc, którego main wywołuje BootCache<...>::write<P>(argv[1]);
+# generator nazwa.cc zapisuje katalog/nazwa_image.h. Generatory są budowane
+# i uruchamiane równolegle, z ASSEMBLER_ENGINE_HASH równym skrótowi
+# computer.h. write nie rusza nagłówka, którego obraz się nie zmienił, więc
+# jednostki od niego zależne nie są przebudowywane.
+# Na standardowe wyjście wypisuje flagę z ASSEMBLER_ENGINE_HASH -- tak samo
+# muszą być kompilowane jednostki dołączające wygenerowane nagłówki.
+# Uruchomienie: ./boot_images.sh katalog generator.cc...
+# Kompilator z CXX, domyślnie g++.
+set -e
+
+if [ $# -lt 2 ]; then
+    echo "usage: $0 directory generator.cc..." >&2
+    exit 2
+fi
+
+cxx=${CXX:-g++}
+out=$1
+shift
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+mkdir -p "$out"
+
+hash=0x$(sha256sum "$here/computer.h" | cut -c1-16)
+flag="-DASSEMBLER_ENGINE_HASH=$hash"
+
+pids=
+for generator in "$@"; do
+    name=$(basename "$generator" .cc)
+    (
+        "$cxx" -std=c++17 -O2 "$flag" -I"$here" -o "$work/$name" "$generator"
+        "$work/$name" "$out/${name}_image.h"
+    ) &
+    pids="$pids $!"
+done
+
+status=0
+for pid in $pids; do
+    wait "$pid" || status=1
+done
+[ "$status" -eq 0 ] || exit "$status"
+
+echo "$flag"
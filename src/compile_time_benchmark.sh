@@ -0,0 +1,58 @@
+#!/bin/sh
+# Czas kompilacji programu z około n instrukcjami, dla kolejnych n. Program
+# składa się z bloków po 9 instrukcji: etykieta, Mov do rejestru, Add, Cmp,
+# skok warunkowy, Inc, druga etykieta, Call podprogramu, Jmp do następnego
+# bloku -- każdy blok ma własne etykiety. Wynik jest sprawdzany przez
+# static_assert, więc program jest też wykonywany w czasie kompilacji.
+# Uruchomienie: ./compile_time_benchmark.sh [kompilator] [n...]
+# Domyślnie g++ i n = 1250 2500 5000 10000 20000. Czas powinien rosnąć
+# liniowo z n.
+set -e
+
+cxx=${1:-g++}
+[ $# -gt 0 ] && shift
+sizes=${*:-1250 2500 5000 10000 20000}
+
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+for n in $sizes; do
+    file="$work/mixed_$n.cc"
+    awk -v n="$n" 'BEGIN {
+        blocks = int(n / 9)
+        print "#include \"computer.h\""
+        print "using P = Program<"
+        print "        D<Id(\"a\"), Num<1>>,"
+        print "        D<Id(\"b\"), Num<0>>,"
+        print "        D<Id(\"c\"), Num<0>>,"
+        print "        D<Id(\"d\"), Num<0>>,"
+        for (k = 0; k < blocks; k++) {
+            r = k % 16
+            printf "        Label<Id(\"l%d\")>,\n", k
+            printf "        Mov<Reg<%d>, Mem<Lea<Id(\"a\")>>>,\n", r
+            printf "        Add<Mem<Lea<Id(\"b\")>>, Reg<%d>>,\n", r
+            print  "        Cmp<Mem<Lea<Id(\"b\")>>, Num<0>>,"
+            printf "        Jl<Id(\"s%d\")>,\n", k
+            print  "        Inc<Mem<Lea<Id(\"c\")>>>,"
+            printf "        Label<Id(\"s%d\")>,\n", k
+            print  "        Call<Id(\"f\")>,"
+            printf "        Jmp<Id(\"l%d\")>,\n", k + 1
+        }
+        printf "        Label<Id(\"l%d\")>,\n", blocks
+        print "        Jmp<Id(\"end\")>,"
+        print "        Label<Id(\"f\")>,"
+        print "        Inc<Mem<Lea<Id(\"d\")>>>,"
+        print "        Ret,"
+        print "        Label<Id(\"end\")>>;"
+        print "constexpr auto result = Computer<64, long>::boot<P>();"
+        printf "static_assert(result[1] == %d && result[2] == %d && " \
+               "result[3] == %d);\n", blocks, blocks, blocks
+    }' > "$file"
+
+    start=$(date +%s.%N)
+    "$cxx" -std=c++17 -fsyntax-only -I"$here" "$file"
+    end=$(date +%s.%N)
+    awk -v n="$n" -v a="$start" -v b="$end" \
+            'BEGIN { printf "n=%d %.2fs\n", n, b - a }'
+done
@@ -3,10 +3,15 @@
 
 #include <array>
 #include <cstddef>
+#include <limits>
 #include <stdexcept>
 #include <string_view>
 #include <tuple>
 #include <type_traits>
+#include <utility>
+
+// Liczba rejestrów Reg<0>...Reg<registerCount - 1>.
+constexpr std::size_t registerCount = 16;
 
 namespace internal {
     constexpr bool isCharacterValid(const char c) {
@@ -27,20 +32,173 @@ namespace internal {
     }
 };
 
+// Stan komputera. Instrukcje korzystają z pamięci wyłącznie przez metody
+// memory, lookup, declare, push, pop oraz operacje atomowe, dzięki czemu
+// silnik może pracować także na stanie rdzenia współdzielącego pamięć
+// z innymi rdzeniami (CoreState w multicore.h).
 template <std::size_t memorySize, typename T>
 struct State {
+    using Word = T;
+    static constexpr std::size_t size = memorySize;
+
     constexpr State()
             : zf(false),
               sf(false),
+              cf(false),
+              of(false),
+              lf(false),
               memoryBlocks(std::array<T, memorySize>()),
               declarationIDs(std::array<uint64_t, memorySize>()),
-              decCount(0) {}
+              decCount(0),
+              sp(memorySize),
+              pc(0),
+              registers() {}
 
     bool zf = false;
+    // Wynik ujemny jako T (dla słowa bez znaku nigdy), po Cmp: a < b.
     bool sf = false;
+    // Przeniesienie i nadmiar, jak dla słowa bez znaku i ze znakiem.
+    bool cf = false;
+    bool of = false;
+    // Wynik mniejszy od zera przed obcięciem do słowa ze znakiem, czyli
+    // SF != OF w x86 -- z niego liczone są warunki L, GE, LE i G.
+    bool lf = false;
     std::array<T, memorySize> memoryBlocks;
     std::array<uint64_t, memorySize> declarationIDs;
     size_t decCount;
+    // Stos rośnie w dół od końca pamięci, sp wskazuje ostatni zajęty element.
+    // Od dołu ogranicza go obszar zadeklarowanych zmiennych. Stos i dane
+    // dzielą pamięć: Mem<Num<k>> sięga też komórek stosu, a zdjęty element
+    // jest zerowany, więc w wyniku boot() nie zostają po nim ślady.
+    size_t sp;
+    // Pozycja następnej instrukcji do wykonania.
+    size_t pc;
+    std::array<T, registerCount> registers;
+
+    constexpr T &memory(size_t addr) {
+        if (addr >= memorySize) {
+            throw std::out_of_range("Memory address out of range");
+        }
+        return memoryBlocks[addr];
+    }
+
+    // Odczyt -- osobno od zapisu, żeby stan śledzący zmiany (np. Snapshot)
+    // mógł odróżnić jedno od drugiego.
+    constexpr const T &memory(size_t addr) const {
+        if (addr >= memorySize) {
+            throw std::out_of_range("Memory address out of range");
+        }
+        return memoryBlocks[addr];
+    }
+
+    constexpr size_t lookup(uint64_t id) const {
+        for (size_t i = 0; i < decCount; i++) {
+            if (id == declarationIDs[i]) return i;
+        }
+        throw std::invalid_argument("Nonexisting ID");
+    }
+
+    constexpr void declare(uint64_t id, T value) {
+        if (decCount == memorySize) {
+            throw std::invalid_argument("Too many declarations");
+        }
+        declarationIDs[decCount] = id;
+        memoryBlocks[decCount] = value;
+        decCount++;
+    }
+
+    constexpr void push(T value) {
+        if (sp == decCount) {
+            throw std::invalid_argument("Stack overflow");
+        }
+        memoryBlocks[--sp] = value;
+    }
+
+    constexpr T pop() {
+        if (sp == memorySize) {
+            throw std::invalid_argument("Stack underflow");
+        }
+        T value = memoryBlocks[sp];
+        memoryBlocks[sp++] = T();
+        return value;
+    }
+
+    // Jeden rdzeń -- operacje atomowe są zwykłymi operacjami.
+    constexpr T exchange(T &cell, T value) {
+        T old = cell;
+        cell = value;
+        return old;
+    }
+
+    constexpr bool compareExchange(T &cell, T &expected, T desired) {
+        if (cell == expected) {
+            cell = desired;
+            return true;
+        }
+        expected = cell;
+        return false;
+    }
+
+    constexpr T fetchAdd(T &cell, T value) {
+        T old = cell;
+        cell += value;
+        return old;
+    }
+
+    constexpr void fence() {}
+};
+
+/* Porty wejścia-wyjścia */
+
+// Stan komputera z portami. Ports dostarcza read(port, value), zwracające
+// false na końcu strumienia, oraz write(port, value).
+template <std::size_t memorySize, typename T, typename Ports>
+struct StreamState : public State<memorySize, T> {
+    constexpr explicit StreamState(Ports &p) : State<memorySize, T>(), ports(&p) {}
+
+    Ports *ports;
+
+    constexpr bool input(size_t port, T &value) {
+        return ports->read(port, value);
+    }
+
+    constexpr void output(size_t port, T value) {
+        ports->write(port, value);
+    }
+};
+
+// Taśmy wejściowa i wyjściowa podpięte pod port 0 -- pozwalają sprawdzić
+// program z portami w czasie kompilacji.
+template <typename T, std::size_t inputSize, std::size_t outputSize>
+struct Tape {
+    constexpr explicit Tape(const std::array<T, inputSize> &in)
+            : input(in), position(0), output(), written(0) {}
+
+    std::array<T, inputSize> input;
+    size_t position;
+    std::array<T, outputSize> output;
+    size_t written;
+
+    constexpr bool read(size_t port, T &value) {
+        if (port != 0) {
+            throw std::invalid_argument("Unbound port");
+        }
+        if (position == inputSize) {
+            return false;
+        }
+        value = input[position++];
+        return true;
+    }
+
+    constexpr void write(size_t port, T value) {
+        if (port != 0) {
+            throw std::invalid_argument("Unbound port");
+        }
+        if (written == outputSize) {
+            throw std::out_of_range("Output tape full");
+        }
+        output[written++] = value;
+    }
 };
 
 constexpr uint64_t Id(const char *id) {
@@ -60,44 +218,168 @@ constexpr uint64_t Id(const char *id) {
     return codedId;
 }
 
+namespace internal {
+    // Typy słowa: typy całkowite oraz __int128 i unsigned __int128, których
+    // std::is_integral i std::make_unsigned nie obsługują w trybie -std=c++NN.
+    template <typename T>
+    struct IsWord : public std::is_integral<T> {};
+
+    template <typename T>
+    struct MakeUnsigned : public std::make_unsigned<T> {};
+
+#ifdef __SIZEOF_INT128__
+    __extension__ typedef __int128 Int128;
+    __extension__ typedef unsigned __int128 UInt128;
+
+    template <>
+    struct IsWord<Int128> : public std::true_type {};
+
+    template <>
+    struct IsWord<UInt128> : public std::true_type {};
+
+    template <>
+    struct MakeUnsigned<Int128> {
+        using type = UInt128;
+    };
+
+    template <>
+    struct MakeUnsigned<UInt128> {
+        using type = UInt128;
+    };
+#endif
+
+    template <typename T>
+    using Unsigned = typename MakeUnsigned<T>::type;
+
+    // Adresy skoków (JmpInd, JmpTable, Ret) są liczone modulo zakres wersji
+    // unsigned typu słowa. Adres, który nie mieści się w size_t, zamieniamy na
+    // największy size_t, żeby odrzuciło go sprawdzenie zakresu.
+    template <typename S>
+    using Address = Unsigned<typename S::Word>;
+
+    template <typename S>
+    constexpr size_t toAddress(Address<S> address) {
+        using Wide = std::common_type_t<Address<S>, size_t>;
+        if (static_cast<Wide>(address) > static_cast<Wide>(~size_t(0))) {
+            return ~size_t(0);
+        }
+        return static_cast<size_t>(address);
+    }
+
+    // Składnik adresu w pamięci jako long long, bez obcinania do słowa;
+    // false, gdy wartość się nie mieści -- taki adres na pewno jest poza
+    // pamięcią.
+    template <typename V>
+    constexpr bool addressPart(V value, long long &part) {
+        constexpr long long max = std::numeric_limits<long long>::max();
+        constexpr long long min = std::numeric_limits<long long>::min();
+        if constexpr (static_cast<V>(-1) < static_cast<V>(0)) {
+            if (value < min || value > max) {
+                return false;
+            }
+        } else if (value > static_cast<unsigned long long>(max)) {
+            return false;
+        }
+        part = static_cast<long long>(value);
+        return true;
+    }
+
+    // base + index * scale + offset na liczbach całkowitych. Wynik ujemny
+    // albo przepełniony zamieniamy na największy size_t, żeby odrzuciło go
+    // sprawdzenie zakresu pamięci -- adres nigdy nie jest zawijany.
+    constexpr size_t linearAddress(long long base, long long index,
+                                   std::ptrdiff_t scale, std::ptrdiff_t offset) {
+        long long address = 0;
+        if (__builtin_mul_overflow(index, static_cast<long long>(scale),
+                                   &address) ||
+            __builtin_add_overflow(address, base, &address) ||
+            __builtin_add_overflow(address, static_cast<long long>(offset),
+                                   &address) ||
+            address < 0 ||
+            static_cast<unsigned long long>(address) > ~size_t(0)) {
+            return ~size_t(0);
+        }
+        return static_cast<size_t>(address);
+    }
+
+    // Adres Mem z wartości Base i Index, każda w swoim typie (Lea daje size_t,
+    // Num -- typ stałej, komórki i rejestry -- typ słowa).
+    template <typename B, typename I>
+    constexpr size_t effectiveAddress(B base, I index, std::ptrdiff_t scale,
+                                      std::ptrdiff_t offset) {
+        long long b = 0;
+        long long i = 0;
+        if (!addressPart(base, b) || !addressPart(index, i)) {
+            return ~size_t(0);
+        }
+        return linearAddress(b, i, scale, offset);
+    }
+};
+
 template <auto V>
 struct Num {
-    static_assert(std::is_integral<decltype(V)>(), "Value is not integral type.");
+    static_assert(internal::IsWord<decltype(V)>(), "Value is not integral type.");
 
-    template <typename T, size_t memorySize>
-    static constexpr auto getRvalue(State<memorySize, T> &) {
+    template <typename S>
+    static constexpr auto getRvalue(S &) {
         return V;
     }
 
     static constexpr auto value = V;
 };
 
-template <typename P>
+// Mem<Base, Index, Scale, Offset> -- komórka pod adresem
+// Base + Index * Scale + Offset; Base i Index to p-wartości, Scale i Offset
+// stałe. Mem<Addr> to zwykłe odwołanie pod adres Addr.
+template <typename Base, typename Index = Num<0>, std::ptrdiff_t scale = 1,
+        std::ptrdiff_t offset = 0>
 struct Mem {
-    template <typename T, size_t memorySize>
-    static constexpr auto &getLvalue(State<memorySize, T> &s) {
-        auto addr = P::template getRvalue<T, memorySize>(s);
-        return s.memoryBlocks[addr];
+    template <typename S>
+    static constexpr size_t address(S &s) {
+        return internal::effectiveAddress(Base::getRvalue(s),
+                                          Index::getRvalue(s), scale, offset);
+    }
+
+    template <typename S>
+    static constexpr auto &getLvalue(S &s) {
+        return s.memory(address(s));
     }
 
-    template <typename T, size_t memorySize>
-    static constexpr auto getRvalue(State<memorySize, T> &s) {
-        auto addr = P::template getRvalue<T, memorySize>(s);
-        return s.memoryBlocks[addr];
+    template <typename S>
+    static constexpr auto getRvalue(S &s) {
+        return std::as_const(s).memory(address(s));
     }
 };
 
 template <uint64_t I>
 struct Lea {
-    template <typename T, size_t memorySize>
-    static constexpr auto getRvalue(State<memorySize, T> &s) {
-        for (size_t i = 0; i < s.decCount; i++) {
-            if (I == s.declarationIDs[i]) return i;
-        }
-        throw std::invalid_argument("Nonexisting ID");
+    template <typename S>
+    static constexpr auto getRvalue(S &s) {
+        return s.lookup(I);
     }
 };
 
+// Rejestr -- komórka poza pamięcią, bez sprawdzania zakresu i bez wyszukiwania.
+template <std::size_t I>
+struct Reg {
+    static_assert(I < registerCount, "Nonexisting register.");
+
+    template <typename S>
+    static constexpr auto &getLvalue(S &s) {
+        return s.registers[I];
+    }
+
+    template <typename S>
+    static constexpr auto getRvalue(S &s) {
+        return s.registers[I];
+    }
+};
+
+// Adres etykiety jako p-wartość, np. do zapisania w pamięci i skoku przez
+// JmpInd. Zamieniany na Num<adres> w czasie kompilacji, przed wykonaniem.
+template <uint64_t I>
+struct LabelAddr {};
+
 /* Instrukcje */
 
 template <typename Dsc, typename Src>
@@ -109,15 +391,104 @@ struct Label {};
 template <uint64_t T>
 struct Jmp {};
 
-template <uint64_t T>
-struct Jz {};
+// Warunki skoków i przesłań warunkowych, jak w x86. B/A porównują słowa
+// bez znaku, L/G ze znakiem. Wyjątkiem jest S/NS: SF oznacza wynik ujemny
+// jako T (po Cmp: a < b), jak w Js sprzed flag CF i OF.
+enum class Cc {
+    O, NO, B, AE, E, NE, BE, A, S, NS, L, GE, LE, G,
+    C = B, NC = AE, Z = E, NZ = NE
+};
 
-template <uint64_t T>
-struct Js {};
+// Jcc<cc, Label> -- skok, gdy spełniony jest warunek cc.
+template <Cc cc, uint64_t T>
+struct Jcc {};
+
+template <uint64_t T> using Jo = Jcc<Cc::O, T>;
+template <uint64_t T> using Jno = Jcc<Cc::NO, T>;
+template <uint64_t T> using Jb = Jcc<Cc::B, T>;
+template <uint64_t T> using Jc = Jcc<Cc::C, T>;
+template <uint64_t T> using Jae = Jcc<Cc::AE, T>;
+template <uint64_t T> using Jnc = Jcc<Cc::NC, T>;
+template <uint64_t T> using Je = Jcc<Cc::E, T>;
+template <uint64_t T> using Jz = Jcc<Cc::Z, T>;
+template <uint64_t T> using Jne = Jcc<Cc::NE, T>;
+template <uint64_t T> using Jnz = Jcc<Cc::NZ, T>;
+template <uint64_t T> using Jbe = Jcc<Cc::BE, T>;
+template <uint64_t T> using Ja = Jcc<Cc::A, T>;
+template <uint64_t T> using Js = Jcc<Cc::S, T>;
+template <uint64_t T> using Jns = Jcc<Cc::NS, T>;
+template <uint64_t T> using Jl = Jcc<Cc::L, T>;
+template <uint64_t T> using Jge = Jcc<Cc::GE, T>;
+template <uint64_t T> using Jle = Jcc<Cc::LE, T>;
+template <uint64_t T> using Jg = Jcc<Cc::G, T>;
+
+// JmpTable<Index, Id0, Id1, ...> -- skok do etykiety o numerze Index na liście.
+// Index spoza listy jest błędem.
+template <typename Index, uint64_t... T>
+struct JmpTable {};
+
+// JmpInd<Src> -- skok pod adres Src, który musi być adresem etykiety.
+template <typename Src>
+struct JmpInd {};
 
 template <uint64_t key, typename value>
 struct D {};
 
+// CMov<cc, Dst, Src> -- Mov wykonywany tylko, gdy spełniony jest warunek cc.
+template <Cc cc, typename Dst, typename Src>
+struct CMov {};
+
+/* Podprogramy i stos */
+
+// Call<Label> -- odkłada adres powrotu na stos i skacze do etykiety. Stos
+// leży w tej samej pamięci co zmienne, od jej końca w dół, więc zapis przez
+// Mem<Num<k>> pod adres zajęty przez stos nadpisuje adres powrotu.
+template <uint64_t T>
+struct Call {};
+
+// Ret -- zdejmuje adres powrotu ze stosu (zerując jego komórkę) i wraca
+// za instrukcję Call.
+struct Ret {};
+
+// Push<Src> -- odkłada Src na stos, w komórce pamięci tuż pod ostatnim
+// zajętym elementem; Pop<Dst> zdejmuje go i zeruje komórkę. Komórki stosu
+// są zwykłą pamięcią, widoczną przez Mem i w wyniku boot().
+template <typename Src>
+struct Push {};
+
+template <typename Dst>
+struct Pop {};
+
+/* Operacje atomowe */
+
+// Xchg<Arg1, Arg2> -- zamienia wartości Arg1 i Arg2; atomowo względem innych
+// rdzeni zmieniane jest tylko Arg1.
+template <typename Arg1, typename Arg2>
+struct Xchg {};
+
+// CmpXchg<Dst, Expected, Desired> -- jeśli Dst == Expected, zapisuje Desired
+// do Dst i ustawia ZF, w przeciwnym wypadku kopiuje Dst do Expected i zeruje ZF.
+template <typename Dst, typename Expected, typename Desired>
+struct CmpXchg {};
+
+// FetchAdd<Dst, Src> -- dodaje Src do Dst, a poprzednią wartość Dst zapisuje
+// w Src. Flagi jak w Add.
+template <typename Dst, typename Src>
+struct FetchAdd {};
+
+struct Fence {};
+
+/* Wejście-wyjście */
+
+// In<Dst, Port> -- wczytuje słowo z portu do Dst. Na końcu strumienia nie
+// zmienia Dst i ustawia ZF, w przeciwnym wypadku zeruje ZF.
+template <typename Dst, std::size_t port>
+struct In {};
+
+// Out<Port, Src> -- wypisuje Src na port.
+template <std::size_t port, typename Src>
+struct Out {};
+
 /* Arytmetyka */
 
 template <typename Arg1, typename Arg2>
@@ -126,6 +497,14 @@ struct Add {};
 template <typename Arg1, typename Arg2>
 struct Sub {};
 
+// Adc<Arg1, Arg2> -- Arg1 += Arg2 + CF, do dodawania liczb wielosłowowych.
+template <typename Arg1, typename Arg2>
+struct Adc {};
+
+// Sbb<Arg1, Arg2> -- Arg1 -= Arg2 + CF.
+template <typename Arg1, typename Arg2>
+struct Sbb {};
+
 template <typename Arg>
 struct Inc {};
 
@@ -153,14 +532,19 @@ struct Cmp {};
 template <typename T>
 struct IsLValue : public std::false_type {};
 
-template <typename T>
-struct IsLValue<Mem<T>> : public std::true_type {};
+template <typename Base, typename Index, std::ptrdiff_t scale,
+        std::ptrdiff_t offset>
+struct IsLValue<Mem<Base, Index, scale, offset>> : public std::true_type {};
+
+template <std::size_t I>
+struct IsLValue<Reg<I>> : public std::true_type {};
 
 template <typename T>
 struct IsRValue : public std::false_type {};
 
-template <typename T>
-struct IsRValue<Mem<T>> : public std::true_type {};
+template <typename Base, typename Index, std::ptrdiff_t scale,
+        std::ptrdiff_t offset>
+struct IsRValue<Mem<Base, Index, scale, offset>> : public std::true_type {};
 
 template <auto V>
 struct IsRValue<Num<V>> : public std::true_type {};
@@ -168,6 +552,12 @@ struct IsRValue<Num<V>> : public std::true_type {};
 template <uint64_t I>
 struct IsRValue<Lea<I>> : public std::true_type {};
 
+template <std::size_t I>
+struct IsRValue<Reg<I>> : public std::true_type {};
+
+template <uint64_t I>
+struct IsRValue<LabelAddr<I>> : public std::true_type {};
+
 /* Co jest poprawną instrukcją */
 
 template <typename T>
@@ -179,6 +569,12 @@ struct isProperInstruction<Add<Arg1, Arg2>> : public std::true_type {};
 template <typename Arg1, typename Arg2>
 struct isProperInstruction<Sub<Arg1, Arg2>> : public std::true_type {};
 
+template <typename Arg1, typename Arg2>
+struct isProperInstruction<Adc<Arg1, Arg2>> : public std::true_type {};
+
+template <typename Arg1, typename Arg2>
+struct isProperInstruction<Sbb<Arg1, Arg2>> : public std::true_type {};
+
 template <typename Arg>
 struct isProperInstruction<Inc<Arg>> : public std::true_type {};
 
@@ -191,17 +587,54 @@ struct isProperInstruction<D<Key, Value>> : public std::true_type {};
 template <typename Dsc, typename Src>
 struct isProperInstruction<Mov<Dsc, Src>> : public std::true_type {};
 
+template <Cc cc, typename Dst, typename Src>
+struct isProperInstruction<CMov<cc, Dst, Src>> : public std::true_type {};
+
 template <uint64_t V>
 struct isProperInstruction<Label<V>> : public std::true_type {};
 
 template <uint64_t T>
 struct isProperInstruction<Jmp<T>> : public std::true_type {};
 
-template <uint64_t T>
-struct isProperInstruction<Jz<T>> : public std::true_type {};
+template <Cc cc, uint64_t T>
+struct isProperInstruction<Jcc<cc, T>> : public std::true_type {};
+
+template <typename Index, uint64_t... T>
+struct isProperInstruction<JmpTable<Index, T...>> : public std::true_type {};
+
+template <typename Src>
+struct isProperInstruction<JmpInd<Src>> : public std::true_type {};
 
 template <uint64_t T>
-struct isProperInstruction<Js<T>> : public std::true_type {};
+struct isProperInstruction<Call<T>> : public std::true_type {};
+
+template <>
+struct isProperInstruction<Ret> : public std::true_type {};
+
+template <typename Src>
+struct isProperInstruction<Push<Src>> : public std::true_type {};
+
+template <typename Dst>
+struct isProperInstruction<Pop<Dst>> : public std::true_type {};
+
+template <typename Arg1, typename Arg2>
+struct isProperInstruction<Xchg<Arg1, Arg2>> : public std::true_type {};
+
+template <typename Dst, typename Expected, typename Desired>
+struct isProperInstruction<CmpXchg<Dst, Expected, Desired>>
+        : public std::true_type {};
+
+template <typename Dst, typename Src>
+struct isProperInstruction<FetchAdd<Dst, Src>> : public std::true_type {};
+
+template <>
+struct isProperInstruction<Fence> : public std::true_type {};
+
+template <typename Dst, std::size_t port>
+struct isProperInstruction<In<Dst, port>> : public std::true_type {};
+
+template <std::size_t port, typename Src>
+struct isProperInstruction<Out<port, Src>> : public std::true_type {};
 
 template <typename Arg1, typename Arg2>
 struct isProperInstruction<And<Arg1, Arg2>> : public std::true_type {};
@@ -238,305 +671,1156 @@ struct IsProgram : public std::false_type {};
 template <typename... T>
 struct IsProgram<Program<T...>> : public std::true_type {};
 
-// Tu wyszukuję tylko polecenia D, zeby zaktualizować memory, pozostałe powinny
-// nie modyfikować memory.
-template <size_t memorySize, typename T, typename... Instructions>
-struct InitialInstructionsParsing {
-    constexpr static void evaluate(State<memorySize, T> &) {}
+/* Moduły */
+
+// Module<Export<Id...>, Instrukcje...> -- fragment programu z własną
+// przestrzenią nazw. Etykiety i zmienne zadeklarowane w module, a niewymienione
+// w Export, są widoczne tylko wewnątrz niego. Link<Moduły...> skleja moduły
+// w jeden Program.
+template <uint64_t... ids>
+struct Export {};
+
+template <typename T>
+struct DeclaredId {
+    static constexpr bool declares = false;
+    static constexpr uint64_t id = 0;
 };
 
-template <size_t memorySize, typename T, uint64_t key, typename value,
-        typename... Instructions>
-struct InitialInstructionsParsing<memorySize, T,
-        std::tuple<D<key, value>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        if(s.decCount == memorySize) {
-            throw std::invalid_argument("Too many declarations");
-        }
-        s.declarationIDs[s.decCount] = key;
-        s.memoryBlocks[s.decCount] = value::value;
-        s.decCount++;
-        InitialInstructionsParsing<memorySize, T,
-                std::tuple<Instructions...>>::evaluate(s);
+template <uint64_t key, typename value>
+struct DeclaredId<D<key, value>> {
+    static constexpr bool declares = true;
+    static constexpr uint64_t id = key;
+};
+
+template <uint64_t key>
+struct DeclaredId<Label<key>> {
+    static constexpr bool declares = true;
+    static constexpr uint64_t id = key;
+};
+
+template <typename Exports, typename... T>
+struct Module;
+
+template <uint64_t... exported, typename... T>
+struct Module<Export<exported...>, T...> {
+    using Instructions = std::tuple<T...>;
+
+    static constexpr bool declares(uint64_t id) {
+        return ((DeclaredId<T>::declares && DeclaredId<T>::id == id) || ...);
+    }
+
+    static constexpr bool isLocal(uint64_t id) {
+        bool isExported = ((exported == id) || ...);
+        return declares(id) && !isExported;
+    }
+
+    // Czy moduł deklaruje nazwę id jako globalną.
+    static constexpr bool defines(uint64_t id) {
+        return declares(id) && !isLocal(id);
+    }
+
+    // Czy check jest spełnione dla każdej eksportowanej nazwy.
+    static constexpr bool allExports(bool (*check)(uint64_t)) {
+        return (true && ... && check(exported));
     }
 };
 
-template <size_t memorySize, typename T, typename SingleInstruction,
-        typename... Instructions>
-struct InitialInstructionsParsing<
-        memorySize, T, std::tuple<SingleInstruction, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        static_assert(isProperInstruction<SingleInstruction>::value,
-                      "This is not a valid instruction.");
-        InitialInstructionsParsing<memorySize, T,
-                std::tuple<Instructions...>>::evaluate(s);
+namespace internal {
+    // Id zajmuje co najwyżej 48 bitów, na starszych bitach zapisujemy numer
+    // modułu, w którym nazwa jest lokalna.
+    constexpr uint64_t scopedId(size_t scope, uint64_t id) {
+        return id | (static_cast<uint64_t>(scope) << 48);
     }
 };
 
-/* Parsowanie instrukcji */
+// Localize podmienia lokalne nazwy modułu w instrukcji i jej argumentach.
+template <size_t scope, typename M, typename X>
+struct Localize {
+    using type = X;
+};
+
+template <size_t scope, typename M, uint64_t id>
+struct LocalizedId {
+    static constexpr uint64_t value =
+            M::isLocal(id) ? internal::scopedId(scope, id) : id;
+};
+
+template <size_t scope, typename M, template <typename...> class Op,
+        typename... Args>
+struct Localize<scope, M, Op<Args...>> {
+    using type = Op<typename Localize<scope, M, Args>::type...>;
+};
+
+template <size_t scope, typename M, uint64_t key, typename value>
+struct Localize<scope, M, D<key, value>> {
+    using type = D<LocalizedId<scope, M, key>::value, value>;
+};
+
+template <size_t scope, typename M, typename Base, typename Index,
+        std::ptrdiff_t scale, std::ptrdiff_t offset>
+struct Localize<scope, M, Mem<Base, Index, scale, offset>> {
+    using type = Mem<typename Localize<scope, M, Base>::type,
+            typename Localize<scope, M, Index>::type, scale, offset>;
+};
+
+template <size_t scope, typename M, uint64_t I>
+struct Localize<scope, M, Lea<I>> {
+    using type = Lea<LocalizedId<scope, M, I>::value>;
+};
 
-// passedLabel jest ustawiany na false przy wykonaniu skoku,
-// zmieniany na true po znalezieniu odpowiedniego Label
-// gdy passedLabel = false, instrukcja nie jest wykonywana
-template <size_t memorySize, typename T, typename JumpLabel, bool passedLabel,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner {
-    constexpr static void evaluate(State<memorySize, T> &) {}
+template <size_t scope, typename M, uint64_t I>
+struct Localize<scope, M, LabelAddr<I>> {
+    using type = LabelAddr<LocalizedId<scope, M, I>::value>;
 };
 
-template <size_t memorySize, typename T, typename keyLabel,
-        typename InstructionsOrigin, typename SingleInstruction,
-        typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, false, InstructionsOrigin,
-        std::tuple<SingleInstruction, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        // Sprawdzenie poprawności omijanej instrukcji SingleInstruction
-        if(false) {
-            InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                    std::tuple<SingleInstruction>>::evaluate(s);
+template <size_t scope, typename M, uint64_t I>
+struct Localize<scope, M, Label<I>> {
+    using type = Label<LocalizedId<scope, M, I>::value>;
+};
+
+template <size_t scope, typename M, uint64_t I>
+struct Localize<scope, M, Jmp<I>> {
+    using type = Jmp<LocalizedId<scope, M, I>::value>;
+};
+
+template <size_t scope, typename M, Cc cc, uint64_t I>
+struct Localize<scope, M, Jcc<cc, I>> {
+    using type = Jcc<cc, LocalizedId<scope, M, I>::value>;
+};
+
+template <size_t scope, typename M, Cc cc, typename Dst, typename Src>
+struct Localize<scope, M, CMov<cc, Dst, Src>> {
+    using type = CMov<cc, typename Localize<scope, M, Dst>::type,
+            typename Localize<scope, M, Src>::type>;
+};
+
+template <size_t scope, typename M, typename Index, uint64_t... I>
+struct Localize<scope, M, JmpTable<Index, I...>> {
+    using type = JmpTable<typename Localize<scope, M, Index>::type,
+            LocalizedId<scope, M, I>::value...>;
+};
+
+template <size_t scope, typename M, uint64_t I>
+struct Localize<scope, M, Call<I>> {
+    using type = Call<LocalizedId<scope, M, I>::value>;
+};
+
+template <size_t scope, typename M, typename Dst, size_t port>
+struct Localize<scope, M, In<Dst, port>> {
+    using type = In<typename Localize<scope, M, Dst>::type, port>;
+};
+
+template <size_t scope, typename M, size_t port, typename Src>
+struct Localize<scope, M, Out<port, Src>> {
+    using type = Out<port, typename Localize<scope, M, Src>::type>;
+};
+
+// Moduł przetłumaczony na Program jest zapamiętywany przez kompilator, więc
+// ten sam moduł na tej samej pozycji nie jest przetwarzany ponownie.
+template <size_t scope, typename M, typename Instructions = typename M::Instructions>
+struct LocalizedModule;
+
+template <size_t scope, typename M, typename... T>
+struct LocalizedModule<scope, M, std::tuple<T...>> {
+    using type = Program<typename Localize<scope, M, T>::type...>;
+};
+
+template <typename... Programs>
+struct ProgramCat {
+    using type = Program<>;
+};
+
+template <typename... T>
+struct ProgramCat<Program<T...>> {
+    using type = Program<T...>;
+};
+
+template <typename... First, typename... Second, typename... Rest>
+struct ProgramCat<Program<First...>, Program<Second...>, Rest...> {
+    using type = typename ProgramCat<Program<First..., Second...>, Rest...>::type;
+};
+
+template <typename Scopes, typename... Modules>
+struct Linker;
+
+template <size_t... scopes, typename... Modules>
+struct Linker<std::index_sequence<scopes...>, Modules...> {
+    static constexpr bool definedOnce(uint64_t id) {
+        return (size_t(0) + ... + size_t(Modules::defines(id))) <= 1;
+    }
+
+    static_assert((Modules::allExports(&definedOnce) && ...),
+                  "Duplicate exported ID.");
+
+    // Zakres 0 oznacza nazwy globalne.
+    using type = typename ProgramCat<
+            typename LocalizedModule<scopes + 1, Modules>::type...>::type;
+};
+
+template <typename... Modules>
+using Link = typename Linker<std::index_sequence_for<Modules...>,
+        Modules...>::type;
+
+/* Adresy etykiet */
+
+// Cechy instrukcji czytane w rozwinięciach całego programu są wyliczeniami albo
+// klasami bazowymi std::integral_constant, a nie statycznymi stałymi: g++
+// instancjonuje inicjalizator statycznej stałej osobno dla każdej instrukcji,
+// co przy tysiącach instrukcji w jednym rozwinięciu kosztuje czas kwadratowy.
+template <typename T>
+struct LabelId {
+    enum : bool { isLabel = false };
+    enum : uint64_t { id = 0 };
+};
+
+template <uint64_t key>
+struct LabelId<Label<key>> {
+    enum : bool { isLabel = true };
+    enum : uint64_t { id = key };
+};
+
+template <typename T>
+struct IsCall : public std::false_type {};
+
+template <uint64_t label>
+struct IsCall<Call<label>> : public std::true_type {};
+
+namespace internal {
+    struct LabelEntry {
+        uint64_t id;
+        size_t address;
+    };
+
+    // Pojemność tablicy haszującej etykiet: potęga dwójki, co najmniej dwa
+    // razy większa od liczby etykiet, więc zawsze zostaje wolne miejsce.
+    constexpr size_t labelCapacity(size_t count) {
+        size_t capacity = 2;
+        while (capacity < 2 * count) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    // Pierwsze miejsce, pod którym szukamy etykiety. Id to bajty nazwy, więc
+    // mieszamy je mnożeniem.
+    constexpr size_t labelSlot(uint64_t id, size_t capacity) {
+        return static_cast<size_t>((id * 0x9E3779B97F4A7C15ull) >> 32) &
+               (capacity - 1);
+    }
+
+    // Adres etykiety id w tablicy haszującej entries albo none, gdy jej nie
+    // ma. Wolne miejsca mają adres none.
+    template <typename Entries>
+    constexpr size_t findLabel(const Entries &entries, uint64_t id,
+                               size_t none) {
+        size_t slot = labelSlot(id, entries.size());
+        while (entries[slot].address != none && entries[slot].id != id) {
+            slot = (slot + 1) & (entries.size() - 1);
+        }
+        return entries[slot].address;
+    }
+
+    // Tablice etykiet rozwinięte z paczki instrukcji, budowane raz na program.
+    template <typename Origin, typename Instructions = Origin>
+    struct LabelTable;
+
+    template <typename Origin, typename... Instructions>
+    struct LabelTable<Origin, std::tuple<Instructions...>> {
+        // Pętla, a nie wyrażenie fold -- g++ składa fold po tysiącach
+        // instrukcji w czasie kwadratowym.
+        static constexpr size_t countLabels() {
+            constexpr bool isLabel[] = {LabelId<Instructions>::isLabel...,
+                                        false};
+            size_t count = 0;
+            for (size_t i = 0; i < sizeof...(Instructions); i++) {
+                count += isLabel[i];
+            }
+            return count;
         }
-        InstructionsRunner<memorySize, T, keyLabel, false, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+
+        static constexpr size_t count = countLabels();
+        static constexpr size_t capacity = labelCapacity(count);
+
+        static constexpr std::array<bool, sizeof...(Instructions) + 1>
+        labels() {
+            return {LabelId<Instructions>::isLabel..., false};
+        }
+
+        static constexpr std::array<bool, sizeof...(Instructions) + 1> calls() {
+            return {IsCall<Instructions>::value..., false};
+        }
+
+        // Tablica haszująca (id, adres) z adresowaniem otwartym. Wolne
+        // miejsca mają adres równy długości programu. Etykiety są wstawiane
+        // w kolejności adresów, a powtórzone id jest pomijane, więc zostaje
+        // pierwsze wystąpienie.
+        static constexpr std::array<LabelEntry, capacity> entries() {
+            constexpr size_t none = sizeof...(Instructions);
+            constexpr bool isLabel[] = {LabelId<Instructions>::isLabel...,
+                                        false};
+            constexpr uint64_t ids[] = {LabelId<Instructions>::id..., 0};
+            std::array<LabelEntry, capacity> entries{};
+            for (size_t slot = 0; slot < entries.size(); slot++) {
+                entries[slot].address = none;
+            }
+            for (size_t i = 0; i < none; i++) {
+                if (!isLabel[i]) continue;
+                size_t slot = labelSlot(ids[i], entries.size());
+                while (entries[slot].address != none &&
+                       entries[slot].id != ids[i]) {
+                    slot = (slot + 1) & (entries.size() - 1);
+                }
+                if (entries[slot].address == none) {
+                    entries[slot] = LabelEntry{ids[i], i};
+                }
+            }
+            return entries;
+        }
+    };
+};
+
+// Adresem etykiety jest jej pozycja w programie. Przy powtórzonej etykiecie
+// wygrywa pierwsze wystąpienie. Etykiety są wyszukiwane w tablicy haszującej,
+// żeby rozwiązanie wszystkich skoków programu kosztowało O(n), a nie O(n^2).
+template <typename Instructions>
+struct LabelAddresses {
+    using Table = internal::LabelTable<Instructions>;
+
+    static constexpr size_t none = std::tuple_size<Instructions>::value;
+
+    static constexpr auto entries = Table::entries();
+    // Czy instrukcja jest etykietą, czy Call.
+    static constexpr auto label = Table::labels();
+    static constexpr auto call = Table::calls();
+
+    static constexpr size_t find(uint64_t id) {
+        return internal::findLabel(entries, id, none);
+    }
+
+    template <uint64_t id>
+    static constexpr size_t address() {
+        constexpr size_t addr = find(id);
+        if (addr == none) {
+            throw std::invalid_argument("Non-existent label");
+        }
+        return addr;
+    }
+
+    // Czy pod adresem addr stoi etykieta -- jedyny dozwolony cel JmpInd.
+    static constexpr bool isLabelAt(size_t addr) {
+        return addr < none && label[addr];
+    }
+
+    // Czy addr to adres powrotu, czyli adres za instrukcją Call -- jedyny
+    // dozwolony cel Ret.
+    static constexpr bool isReturnAddress(size_t addr) {
+        return addr > 0 && addr <= none && call[addr - 1];
+    }
+};
+
+// Zamiana LabelAddr<Id> w operandach instrukcji na Num<adres etykiety>.
+// Nieistniejąca etykieta jest błędem kompilacji.
+template <typename Instructions, typename X>
+struct ResolveLabels {
+    using type = X;
+};
+
+template <typename Instructions, uint64_t I>
+struct ResolveLabels<Instructions, LabelAddr<I>> {
+    using type = Num<LabelAddresses<Instructions>::template address<I>()>;
+};
+
+template <typename Instructions, template <typename...> class Op,
+        typename... Args>
+struct ResolveLabels<Instructions, Op<Args...>> {
+    using type = Op<typename ResolveLabels<Instructions, Args>::type...>;
+};
+
+template <typename Instructions, uint64_t key, typename value>
+struct ResolveLabels<Instructions, D<key, value>> {
+    using type = D<key, typename ResolveLabels<Instructions, value>::type>;
+};
+
+template <typename Instructions, typename Base, typename Index,
+        std::ptrdiff_t scale, std::ptrdiff_t offset>
+struct ResolveLabels<Instructions, Mem<Base, Index, scale, offset>> {
+    using type = Mem<typename ResolveLabels<Instructions, Base>::type,
+            typename ResolveLabels<Instructions, Index>::type, scale, offset>;
+};
+
+template <typename Instructions, Cc cc, typename Dst, typename Src>
+struct ResolveLabels<Instructions, CMov<cc, Dst, Src>> {
+    using type = CMov<cc, typename ResolveLabels<Instructions, Dst>::type,
+            typename ResolveLabels<Instructions, Src>::type>;
+};
+
+template <typename Instructions, typename Index, uint64_t... I>
+struct ResolveLabels<Instructions, JmpTable<Index, I...>> {
+    using type = JmpTable<typename ResolveLabels<Instructions, Index>::type,
+            I...>;
+};
+
+template <typename Instructions, typename Dst, size_t port>
+struct ResolveLabels<Instructions, In<Dst, port>> {
+    using type = In<typename ResolveLabels<Instructions, Dst>::type, port>;
+};
+
+template <typename Instructions, size_t port, typename Src>
+struct ResolveLabels<Instructions, Out<port, Src>> {
+    using type = Out<port, typename ResolveLabels<Instructions, Src>::type>;
+};
+
+
+// Tu wyszukuję tylko polecenia D, zeby zaktualizować memory, pozostałe powinny
+// nie modyfikować memory.
+template <typename S, typename Instruction>
+struct Declaration {
+    static_assert(isProperInstruction<Instruction>::value,
+                  "This is not a valid instruction.");
+
+    constexpr static void evaluate(S &) {}
+};
+
+template <typename S, uint64_t key, typename value>
+struct Declaration<S, D<key, value>> {
+    constexpr static void evaluate(S &s) {
+        s.declare(key, value::value);
     }
 };
 
-// Jeśli nie ma już instrukcji, a Label nie zostało znalezione, rzuca wyjątek
-template <size_t memorySize, typename T, typename keyLabel,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, false, InstructionsOrigin,
+// Krotka programu osobnym parametrem, jak w InstructionsRunner.
+template <typename S, typename InstructionsOrigin,
+        typename Instructions = InstructionsOrigin>
+struct InitialInstructionsParsing;
+
+template <typename S, typename InstructionsOrigin, typename... Instructions>
+struct InitialInstructionsParsing<S, InstructionsOrigin,
         std::tuple<Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &) {
-        throw std::invalid_argument("Non-existent label");
+    using Step = void (*)(S &);
+
+    constexpr static void evaluate(S &s) {
+        constexpr Step declarations[] = {
+                &Declaration<S, typename ResolveLabels<InstructionsOrigin,
+                        Instructions>::type>::evaluate...,
+                nullptr};
+        for (size_t i = 0; i < sizeof...(Instructions); i++) {
+            declarations[i](s);
+        }
     }
 };
 
-template <size_t memorySize, typename T, typename keyLabel,
-        typename InstructionsOrigin, typename SingleInstruction,
-        typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<SingleInstruction, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+/* Bloki podstawowe */
+
+// Jak sterowanie opuszcza instrukcję: przechodzi do następnej (Next), skacze
+// pod target (Jump), skacze pod target albo przechodzi dalej (Branch),
+// wchodzi do podprogramu pod target, a Ret wraca za Call (Call), wraca za
+// którąś instrukcję Call (Return) albo skacze do którejś etykiety (Indirect:
+// JmpTable i JmpInd). ControlFlow<T>::value to Flow instrukcji T; Jump, Branch
+// i Call skaczą do etykiety label.
+enum class Flow : uint8_t { Next, Jump, Branch, Call, Return, Indirect };
+
+template <typename T>
+struct ControlFlow : public std::integral_constant<Flow, Flow::Next> {
+    enum : uint64_t { label = 0 };
+};
+
+template <uint64_t id>
+struct ControlFlow<Jmp<id>> : public std::integral_constant<Flow, Flow::Jump> {
+    enum : uint64_t { label = id };
+};
+
+template <Cc cc, uint64_t id>
+struct ControlFlow<Jcc<cc, id>>
+        : public std::integral_constant<Flow, Flow::Branch> {
+    enum : uint64_t { label = id };
+};
+
+template <uint64_t id>
+struct ControlFlow<Call<id>> : public std::integral_constant<Flow, Flow::Call> {
+    enum : uint64_t { label = id };
+};
+
+template <>
+struct ControlFlow<Ret> : public std::integral_constant<Flow, Flow::Return> {
+    enum : uint64_t { label = 0 };
+};
+
+template <typename Index, uint64_t... T>
+struct ControlFlow<JmpTable<Index, T...>>
+        : public std::integral_constant<Flow, Flow::Indirect> {
+    enum : uint64_t { label = 0 };
+};
+
+template <typename Src>
+struct ControlFlow<JmpInd<Src>>
+        : public std::integral_constant<Flow, Flow::Indirect> {
+    enum : uint64_t { label = 0 };
+};
+
+namespace internal {
+    // Tablice rozwinięte z paczki instrukcji. Dane statyczne klasy
+    // sparametryzowanej całą paczką są w wyrażeniach stałych drogie (g++
+    // przy każdym odczycie przechodzi po argumentach szablonu, czyli O(n)),
+    // więc tablice budują funkcje na zmiennych lokalnych, a cele wszystkich
+    // skoków są liczone w jednym wyrażeniu, a nie osobno dla każdej etykiety.
+    template <typename Origin, typename Instructions = Origin>
+    struct ProgramShape;
+
+    template <typename Origin, typename... Instructions>
+    struct ProgramShape<Origin, std::tuple<Instructions...>> {
+        static constexpr std::array<Flow, sizeof...(Instructions) + 1> flow() {
+            return {ControlFlow<Instructions>::value..., Flow::Next};
+        }
+
+        // Adres etykiety, do której skacze instrukcja (Jump, Branch, Call).
+        // Nieistniejąca etykieta ma adres równy długości programu -- skok do
+        // niej jest błędem dopiero, gdy zostanie wykonany.
+        static constexpr std::array<size_t, sizeof...(Instructions) + 1>
+        targets() {
+            constexpr size_t none = sizeof...(Instructions);
+            constexpr Flow flows[] = {ControlFlow<Instructions>::value...,
+                                      Flow::Next};
+            constexpr uint64_t labels[] = {ControlFlow<Instructions>::label...,
+                                           0};
+            auto entries = LabelTable<Origin>::entries();
+            std::array<size_t, none + 1> targets{};
+            for (size_t i = 0; i < none; i++) {
+                if (flows[i] == Flow::Jump || flows[i] == Flow::Branch ||
+                    flows[i] == Flow::Call) {
+                    targets[i] = findLabel(entries, labels[i], none);
+                }
+            }
+            return targets;
+        }
+    };
+};
+
+// Podział programu na bloki podstawowe i graf przepływu między nimi. Blok
+// zaczyna się na początku programu, na etykiecie i za instrukcją, która nie
+// przechodzi do następnej (flow != Next), a kończy taką instrukcją, przed
+// etykietą albo na końcu programu. Krawędzie wychodzą z ostatniej instrukcji
+// bloku zgodnie z jej flow i target: Next i Branch prowadzą do następnego
+// bloku, Jump, Branch i Call do bloku pod target, Return do bloków za
+// instrukcjami Call, a Indirect do bloków zaczynających się etykietą. Skoki
+// prowadzą tylko do etykiet, a Ret zwykle do instrukcji za Call, więc
+// wykonanie wchodzi do bloku od jego początku; dowolny inny adres (np. zdjęty
+// ze stosu przez Ret) też jest obsługiwany.
+template <typename Instructions>
+struct BasicBlocks {
+    static constexpr size_t size = std::tuple_size<Instructions>::value;
+
+    using Shape = internal::ProgramShape<Instructions>;
+
+    struct Layout {
+        // Początki kolejnych bloków, start[count] == size.
+        std::array<size_t, size + 1> start;
+        // Koniec (pierwszy adres za) bloku, do którego należy instrukcja.
+        std::array<size_t, size + 1> end;
+        // Dla każdej instrukcji: jak opuszcza ją sterowanie i cel skoku.
+        std::array<Flow, size + 1> flow;
+        std::array<size_t, size + 1> target;
+        // Czy instrukcja jest etykietą, czy Call.
+        std::array<bool, size + 1> label;
+        std::array<bool, size + 1> call;
+        size_t count;
+    };
+
+    static constexpr Layout build() {
+        constexpr size_t n = size;
+        Layout layout{{}, {}, Shape::flow(), Shape::targets(),
+                      LabelAddresses<Instructions>::label,
+                      LabelAddresses<Instructions>::call, 0};
+        for (size_t i = 0; i < n; i++) {
+            if (i == 0 || layout.label[i] || layout.flow[i - 1] != Flow::Next) {
+                layout.start[layout.count++] = i;
+            }
+        }
+        layout.start[layout.count] = n;
+        // Koniec bloku to początek następnego.
+        size_t block = layout.count;
+        for (size_t i = n; i-- > 0;) {
+            layout.end[i] = layout.start[block];
+            if (layout.start[block - 1] == i) {
+                block--;
+            }
+        }
+        return layout;
+    }
+
+    static constexpr Layout layout = build();
+
+    // Czy blok zaczynający się pod adresem next jest następnikiem bloku
+    // kończącego się instrukcją last.
+    static constexpr bool isSuccessor(size_t last, size_t next) {
+        switch (layout.flow[last]) {
+            case Flow::Next:
+                return next == last + 1;
+            case Flow::Jump:
+            case Flow::Call:
+                return next == layout.target[last];
+            case Flow::Branch:
+                return next == last + 1 || next == layout.target[last];
+            case Flow::Return:
+                return next > 0 && next <= size && layout.call[next - 1];
+            case Flow::Indirect:
+                return next < size && layout.label[next];
+        }
+        return false;
     }
 };
 
-// Label
-template <size_t memorySize, typename T, uint64_t keyLabel, uint64_t keyLabel2,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, Label<keyLabel>, false,
-        InstructionsOrigin,
-        std::tuple<Label<keyLabel2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        InstructionsRunner<memorySize, T, Label<keyLabel>, keyLabel == keyLabel2,
-                InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+/* Flagi */
+
+namespace internal {
+    template <typename T>
+    constexpr bool signBit(T value) {
+        using U = Unsigned<T>;
+        return static_cast<U>(value) > (static_cast<U>(~U(0)) >> 1);
+    }
+
+    template <typename T>
+    constexpr bool isSigned = !std::is_same<T, Unsigned<T>>::value;
+
+    // Wynik operacji zapisywany do słowa. ZF i SF liczone z tego słowa, LF
+    // z najstarszego bitu i nadmiaru (OF ustawione wcześniej).
+    template <typename S, typename U>
+    constexpr typename S::Word setResult(S &s, U result) {
+        using T = typename S::Word;
+        s.zf = result == 0;
+        s.sf = isSigned<T> && signBit(result);
+        s.lf = signBit(result) != s.of;
+        return static_cast<T>(result);
+    }
+
+    // a + b + carry z flagami. Liczone na słowach bez znaku, więc nadmiar nie
+    // jest zachowaniem niezdefiniowanym także w czasie kompilacji.
+    template <typename S, typename A, typename B>
+    constexpr typename S::Word add(S &s, A a, B b, bool carry = false) {
+        using U = Unsigned<typename S::Word>;
+        U x = static_cast<U>(a);
+        U y = static_cast<U>(b);
+        U result = static_cast<U>(x + y + carry);
+        s.cf = result < x || (carry && result == x);
+        s.of = signBit(static_cast<U>((x ^ result) & (y ^ result)));
+        return setResult(s, result);
+    }
+
+    // a - b - borrow z flagami, jak w x86: CF to pożyczka.
+    template <typename S, typename A, typename B>
+    constexpr typename S::Word sub(S &s, A a, B b, bool borrow = false) {
+        using U = Unsigned<typename S::Word>;
+        U x = static_cast<U>(a);
+        U y = static_cast<U>(b);
+        U result = static_cast<U>(x - y - borrow);
+        s.cf = x < y || (borrow && x == y);
+        s.of = signBit(static_cast<U>((x ^ y) & (x ^ result)));
+        return setResult(s, result);
+    }
+
+    template <typename S>
+    constexpr bool holds(Cc cc, const S &s) {
+        switch (cc) {
+            case Cc::O: return s.of;
+            case Cc::NO: return !s.of;
+            case Cc::B: return s.cf;
+            case Cc::AE: return !s.cf;
+            case Cc::E: return s.zf;
+            case Cc::NE: return !s.zf;
+            case Cc::BE: return s.cf || s.zf;
+            case Cc::A: return !s.cf && !s.zf;
+            case Cc::S: return s.sf;
+            case Cc::NS: return !s.sf;
+            case Cc::L: return s.lf;
+            case Cc::GE: return !s.lf;
+            case Cc::LE: return s.zf || s.lf;
+            case Cc::G: return !s.zf && !s.lf;
+        }
+        return false;
     }
 };
 
-// Dla polecenia Jmp program rusza od początku tylko z tą nową labelką i flagą
-// passedLabel na false.
+/* Wykonywanie instrukcji */
+
+// InstructionEvaluator wykonuje instrukcję spod adresu pc. Skoki ustawiają pc
+// na następną instrukcję do wykonania, pozostałe instrukcje pc nie dotykają.
+// Wyjątkiem są skoki do etykiet (Jmp, Jcc, Call): adres etykiety bierze
+// InstructionsRunner z tablicy celów BasicBlocks, a Jcc tylko przesuwa pc,
+// gdy skok nie jest wykonywany. Cel Ret i JmpInd sprawdza InstructionsRunner.
+// Nie zależy od pozycji instrukcji, więc powtórzone instrukcje programu są
+// instancjonowane tylko raz.
+template <typename S, typename InstructionsOrigin,
+        typename Instruction>
+struct InstructionEvaluator {
+    constexpr static void evaluate(S &) {}
+};
+
+// Jmp -- cały skok wykonuje InstructionsRunner.
+template <typename S, typename InstructionsOrigin,
+        uint64_t label>
+struct InstructionEvaluator<S, InstructionsOrigin, Jmp<label>> {
+    constexpr static void evaluate(S &) {}
+};
 
-// Jmp
-template <size_t memorySize, typename T, typename keyLabel, uint64_t newLabel,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Jmp<newLabel>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        InstructionsRunner<memorySize, T, Label<newLabel>, false,
-                InstructionsOrigin, InstructionsOrigin>::evaluate(s);
+// Jcc -- pc zostaje na skoku, gdy warunek zachodzi; wtedy InstructionsRunner
+// skacze do etykiety.
+template <typename S, typename InstructionsOrigin, Cc cc,
+        uint64_t label>
+struct InstructionEvaluator<S, InstructionsOrigin, Jcc<cc, label>> {
+    constexpr static void evaluate(S &s) {
+        if (!internal::holds(cc, s)) {
+            s.pc++;
+        }
     }
 };
 
-// Js
-template <size_t memorySize, typename T, typename keyLabel, uint64_t newLabel,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Js<newLabel>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        if (s.sf) {
-            InstructionsRunner<memorySize, T, Label<newLabel>, false,
-                    InstructionsOrigin, InstructionsOrigin>::evaluate(s);
-        } else {
-            InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                    std::tuple<Instructions...>>::evaluate(s);
+// JmpTable -- adresy etykiet są znane w czasie kompilacji, wybór celu to
+// jedno odwołanie do tablicy.
+template <typename S, typename InstructionsOrigin, typename Index,
+        uint64_t... labels>
+struct InstructionEvaluator<S, InstructionsOrigin, JmpTable<Index, labels...>> {
+    constexpr static void evaluate(S &s) {
+        constexpr size_t targets[] = {
+                LabelAddresses<InstructionsOrigin>::template address<labels>()...,
+                0};
+        size_t index = internal::toAddress<S>(
+                static_cast<internal::Address<S>>(Index::getRvalue(s)));
+        if (index >= sizeof...(labels)) {
+            throw std::out_of_range("Jump table index out of range");
         }
+        s.pc = targets[index];
     }
 };
 
-// Jz
-template <size_t memorySize, typename T, typename keyLabel, uint64_t newLabel,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Jz<newLabel>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        if (s.zf) {
-            InstructionsRunner<memorySize, T, Label<newLabel>, false,
-                    InstructionsOrigin, InstructionsOrigin>::evaluate(s);
-        } else {
-            InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                    std::tuple<Instructions...>>::evaluate(s);
+// JmpInd -- to, że pod adresem stoi etykieta, sprawdza InstructionsRunner.
+template <typename S, typename InstructionsOrigin, typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, JmpInd<Src>> {
+    constexpr static void evaluate(S &s) {
+        s.pc = internal::toAddress<S>(
+                static_cast<internal::Address<S>>(Src::getRvalue(s)));
+    }
+};
+
+// Call -- adres następnej instrukcji trafia na stos, dalej jak Jmp.
+template <typename S, typename InstructionsOrigin,
+        uint64_t label>
+struct InstructionEvaluator<S, InstructionsOrigin, Call<label>> {
+    constexpr static void evaluate(S &s) {
+        size_t returnAddress = s.pc + 1;
+        if (static_cast<size_t>(static_cast<typename S::Word>(returnAddress)) != returnAddress) {
+            throw std::invalid_argument("Return address out of range");
         }
+        s.push(static_cast<typename S::Word>(returnAddress));
+    }
+};
+
+// Ret -- to, że adres jest adresem powrotu, sprawdza InstructionsRunner.
+template <typename S, typename InstructionsOrigin>
+struct InstructionEvaluator<S, InstructionsOrigin, Ret> {
+    constexpr static void evaluate(S &s) {
+        s.pc = internal::toAddress<S>(
+                static_cast<internal::Address<S>>(s.pop()));
+    }
+};
+
+// Push
+template <typename S, typename InstructionsOrigin,
+        typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, Push<Src>> {
+    constexpr static void evaluate(S &s) {
+        s.push(Src::getRvalue(s));
+    }
+};
+
+// Pop
+template <typename S, typename InstructionsOrigin,
+        typename Dst>
+struct InstructionEvaluator<S, InstructionsOrigin, Pop<Dst>> {
+    constexpr static void evaluate(S &s) {
+        auto value = s.pop();
+        Dst::getLvalue(s) = value;
     }
 };
 
 // Mov
-template <size_t memorySize, typename T, typename keyLabel, typename Dst,
-        typename Src, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Mov<Dst, Src>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Dst::template getLvalue<T, memorySize>(s) =
-                Src::template getRvalue<T, memorySize>(s);
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Dst, typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, Mov<Dst, Src>> {
+    constexpr static void evaluate(S &s) {
+        Dst::getLvalue(s) =
+                Src::getRvalue(s);
+    }
+};
+
+// CMov
+template <typename S, typename InstructionsOrigin, Cc cc,
+        typename Dst, typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, CMov<cc, Dst, Src>> {
+    constexpr static void evaluate(S &s) {
+        if (internal::holds(cc, s)) {
+            Dst::getLvalue(s) = Src::getRvalue(s);
+        }
     }
 };
 
 /* Operacje arytmetyczne */
 
 // Add
-template <size_t memorySize, typename T, typename keyLabel, typename Arg1,
-        typename Arg2, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Add<Arg1, Arg2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg1::template getLvalue<T, memorySize>(s) +=
-                Arg2::template getRvalue<T, memorySize>(s);
-        s.zf = Arg1::template getRvalue<T, memorySize>(s) == 0;
-        s.sf = Arg1::template getRvalue<T, memorySize>(s) < 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        Add<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        auto &dst = Arg1::getLvalue(s);
+        dst = internal::add(s, dst, Arg2::getRvalue(s));
     }
 };
 
 // Sub
-template <size_t memorySize, typename T, typename keyLabel, typename Arg1,
-        typename Arg2, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Sub<Arg1, Arg2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg1::template getLvalue<T, memorySize>(s) -=
-                Arg2::template getRvalue<T, memorySize>(s);
-        s.zf = Arg1::template getRvalue<T, memorySize>(s) == 0;
-        s.sf = Arg1::template getRvalue<T, memorySize>(s) < 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
-    }
-};
-
-// Inc
-template <size_t memorySize, typename T, typename keyLabel, typename Arg,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Inc<Arg>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg::template getLvalue<T, memorySize>(s) += 1;
-        s.zf = Arg::template getRvalue<T, memorySize>(s) == 0;
-        s.sf = Arg::template getRvalue<T, memorySize>(s) < 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
-    }
-};
-
-// Dec
-template <size_t memorySize, typename T, typename keyLabel, typename Arg,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Dec<Arg>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg::template getLvalue<T, memorySize>(s) -= 1;
-        s.zf = Arg::template getRvalue<T, memorySize>(s) == 0;
-        s.sf = Arg::template getRvalue<T, memorySize>(s) < 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        Sub<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        auto &dst = Arg1::getLvalue(s);
+        dst = internal::sub(s, dst, Arg2::getRvalue(s));
+    }
+};
+
+// Adc
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        Adc<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        auto &dst = Arg1::getLvalue(s);
+        dst = internal::add(s, dst, Arg2::getRvalue(s), s.cf);
+    }
+};
+
+// Sbb
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        Sbb<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        auto &dst = Arg1::getLvalue(s);
+        dst = internal::sub(s, dst, Arg2::getRvalue(s), s.cf);
+    }
+};
+
+// Inc -- jak w x86 nie zmienia CF.
+template <typename S, typename InstructionsOrigin,
+        typename Arg>
+struct InstructionEvaluator<S, InstructionsOrigin, Inc<Arg>> {
+    constexpr static void evaluate(S &s) {
+        bool cf = s.cf;
+        auto &dst = Arg::getLvalue(s);
+        dst = internal::add(s, dst, 1);
+        s.cf = cf;
+    }
+};
+
+// Dec -- jak w x86 nie zmienia CF.
+template <typename S, typename InstructionsOrigin,
+        typename Arg>
+struct InstructionEvaluator<S, InstructionsOrigin, Dec<Arg>> {
+    constexpr static void evaluate(S &s) {
+        bool cf = s.cf;
+        auto &dst = Arg::getLvalue(s);
+        dst = internal::sub(s, dst, 1);
+        s.cf = cf;
+    }
+};
+
+/* Operacje atomowe */
+
+// Xchg
+template <typename S, typename InstructionsOrigin, typename Arg1,
+        typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin, Xchg<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        auto &other = Arg2::getLvalue(s);
+        other = s.exchange(Arg1::getLvalue(s), other);
+    }
+};
+
+// CmpXchg
+template <typename S, typename InstructionsOrigin, typename Dst,
+        typename Expected, typename Desired>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        CmpXchg<Dst, Expected, Desired>> {
+    constexpr static void evaluate(S &s) {
+        s.zf = s.compareExchange(Dst::getLvalue(s), Expected::getLvalue(s),
+                                 Desired::getRvalue(s));
+    }
+};
+
+// FetchAdd
+template <typename S, typename InstructionsOrigin, typename Dst,
+        typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, FetchAdd<Dst, Src>> {
+    constexpr static void evaluate(S &s) {
+        auto &src = Src::getLvalue(s);
+        auto value = src;
+        src = s.fetchAdd(Dst::getLvalue(s), value);
+        internal::add(s, src, value);
+    }
+};
+
+// Fence
+template <typename S, typename InstructionsOrigin>
+struct InstructionEvaluator<S, InstructionsOrigin, Fence> {
+    constexpr static void evaluate(S &s) {
+        s.fence();
+    }
+};
+
+/* Wejście-wyjście */
+
+// In
+template <typename S, typename InstructionsOrigin, typename Dst, size_t port>
+struct InstructionEvaluator<S, InstructionsOrigin, In<Dst, port>> {
+    constexpr static void evaluate(S &s) {
+        s.zf = !s.input(port, Dst::getLvalue(s));
+    }
+};
+
+// Out
+template <typename S, typename InstructionsOrigin, size_t port, typename Src>
+struct InstructionEvaluator<S, InstructionsOrigin, Out<port, Src>> {
+    constexpr static void evaluate(S &s) {
+        s.output(port, static_cast<typename S::Word>(Src::getRvalue(s)));
     }
 };
 
 /* Operacje logiczne */
 
 // And
-template <size_t memorySize, typename T, typename keyLabel, typename Arg1,
-        typename Arg2, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<And<Arg1, Arg2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg1::template getLvalue<T, memorySize>(s) =
-                (Arg1::template getRvalue<T, memorySize>(s) &
-                 Arg2::template getRvalue<T, memorySize>(s));
-        s.zf = Arg1::template getRvalue<T, memorySize>(s) == 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        And<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        Arg1::getLvalue(s) =
+                (Arg1::getRvalue(s) &
+                 Arg2::getRvalue(s));
+        s.zf = Arg1::getRvalue(s) == 0;
     }
 };
 
 // Or
-template <size_t memorySize, typename T, typename keyLabel, typename Arg1,
-        typename Arg2, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Or<Arg1, Arg2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg1::template getLvalue<T, memorySize>(s) =
-                (Arg1::template getRvalue<T, memorySize>(s) |
-                 Arg2::template getRvalue<T, memorySize>(s));
-        s.zf = Arg1::template getRvalue<T, memorySize>(s) == 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin, Or<Arg1, Arg2>> {
+    constexpr static void evaluate(S &s) {
+        Arg1::getLvalue(s) =
+                (Arg1::getRvalue(s) |
+                 Arg2::getRvalue(s));
+        s.zf = Arg1::getRvalue(s) == 0;
     }
 };
 
 // Not
-template <size_t memorySize, typename T, typename keyLabel, typename Arg,
-        typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Not<Arg>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        Arg::template getLvalue<T, memorySize>(s) =
-                ~(Arg::template getRvalue<T, memorySize>(s));
-        s.zf = Arg::template getRvalue<T, memorySize>(s) == 0;
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg>
+struct InstructionEvaluator<S, InstructionsOrigin, Not<Arg>> {
+    constexpr static void evaluate(S &s) {
+        Arg::getLvalue(s) =
+                ~(Arg::getRvalue(s));
+        s.zf = Arg::getRvalue(s) == 0;
     }
 };
 
 /* Operacja porownania */
 
-template <size_t memorySize, typename T, typename keyLabel, typename Arg1,
-        typename Arg2, typename InstructionsOrigin, typename... Instructions>
-struct InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-        std::tuple<Cmp<Arg1, Arg2>, Instructions...>> {
-    constexpr static void evaluate(State<memorySize, T> &s) {
-        s.zf = (Arg1::template getRvalue<T, memorySize>(s) ==
-                Arg2::template getRvalue<T, memorySize>(s));
-        s.sf = (Arg1::template getRvalue<T, memorySize>(s) <
-                Arg2::template getRvalue<T, memorySize>(s));
-        InstructionsRunner<memorySize, T, keyLabel, true, InstructionsOrigin,
-                std::tuple<Instructions...>>::evaluate(s);
+template <typename S, typename InstructionsOrigin,
+        typename Arg1, typename Arg2>
+struct InstructionEvaluator<S, InstructionsOrigin,
+        Cmp<Arg1, Arg2>> {
+    // CF, OF i LF jak po odejmowaniu słów typu T; ZF i SF jak przed ich
+    // wprowadzeniem -- z porównania wartości argumentów przed obcięciem do T,
+    // po zwykłych konwersjach arytmetycznych (jawnie, np. dla Lea i int).
+    constexpr static void evaluate(S &s) {
+        using T = typename S::Word;
+        using C = std::common_type_t<decltype(Arg1::getRvalue(s)),
+                decltype(Arg2::getRvalue(s))>;
+        internal::sub(s, static_cast<T>(Arg1::getRvalue(s)),
+                      static_cast<T>(Arg2::getRvalue(s)));
+        s.zf = (static_cast<C>(Arg1::getRvalue(s)) ==
+                static_cast<C>(Arg2::getRvalue(s)));
+        s.sf = (static_cast<C>(Arg1::getRvalue(s)) <
+                static_cast<C>(Arg2::getRvalue(s)));
+    }
+};
+
+/* Parsowanie instrukcji */
+
+// Tablica instrukcji, indeksowana adresem, powstaje z jednego rozwinięcia
+// paczki, więc nie tworzymy żadnych pośrednich typów krotek. Krotkę programu
+// przekazujemy osobnym parametrem -- odtwarzanie jej z paczki przy każdym
+// elemencie rozwinięcia kosztowałoby O(n) na instrukcję.
+// Program wykonuje się blokami podstawowymi: instrukcje wewnątrz bloku idą
+// jedna po drugiej bez sprawdzania i zapisywania pc, dopiero ostatnia
+// instrukcja bloku wybiera następny blok.
+// Każdy odczyt statycznej składowej tej klasy kosztuje w wyrażeniu stałym
+// O(n) (patrz internal::ProgramShape), więc evaluate kopiuje tablice raz do
+// zmiennej lokalnej, a pętle wykonania czytają tylko z niej.
+template <typename S, typename InstructionsOrigin,
+        typename Instructions = InstructionsOrigin>
+struct InstructionsRunner;
+
+template <typename S, typename InstructionsOrigin, typename... Instructions>
+struct InstructionsRunner<S, InstructionsOrigin, std::tuple<Instructions...>> {
+    using Step = void (*)(S &);
+
+    static constexpr size_t size = sizeof...(Instructions);
+
+    // Dla każdej instrukcji: jej wykonanie i pola BasicBlocks::Layout,
+    // z których korzysta wykonanie.
+    struct Dispatch {
+        std::array<Step, size + 1> steps;
+        std::array<size_t, size + 1> end;
+        std::array<Flow, size + 1> flow;
+        std::array<size_t, size + 1> target;
+        std::array<bool, size + 1> label;
+        std::array<bool, size + 1> call;
+    };
+
+    static constexpr Dispatch build() {
+        constexpr auto &blocks = BasicBlocks<InstructionsOrigin>::layout;
+        return {{&InstructionEvaluator<S, InstructionsOrigin,
+                         typename ResolveLabels<InstructionsOrigin,
+                                 Instructions>::type>::evaluate...,
+                 nullptr},
+                blocks.end, blocks.flow, blocks.target, blocks.label,
+                blocks.call};
+    }
+
+    static constexpr Dispatch dispatch = build();
+
+    // Wykonuje jedną instrukcję; zwraca false, gdy program się zakończył.
+    constexpr static bool step(S &s) {
+        if (s.pc >= size) {
+            return false;
+        }
+        size_t address = s.pc;
+        dispatch.steps[address](s);
+        leave(s, address, dispatch);
+        return s.pc < size;
+    }
+
+    constexpr static void evaluate(S &s) {
+        Dispatch local = dispatch;
+        while (s.pc < sizeof...(Instructions)) {
+            runBlock(s, local);
+        }
+    }
+
+    // Wykonuje co najwyżej budget instrukcji i zwraca liczbę wykonanych.
+    // Wykonanie można potem wznowić od s.pc -- cały stan maszyny jest w s.
+    constexpr static size_t run(S &s, size_t budget) {
+        size_t executed = 0;
+        while (s.pc < size && executed < budget) {
+            size_t length = dispatch.end[s.pc] - s.pc;
+            if (length <= budget - executed) {
+                runBlock(s);
+                executed += length;
+            } else {
+                step(s);
+                executed++;
+            }
+        }
+        return executed;
+    }
+
+    // Wykonuje blok podstawowy od s.pc (s.pc < size) i zwraca adres jego
+    // ostatniej instrukcji. Dla wykonań, które coś robią na granicach bloków
+    // (np. profiler).
+    constexpr static size_t runBlock(S &s) {
+        return runBlock(s, dispatch);
+    }
+
+private:
+    constexpr static size_t runBlock(S &s, const Dispatch &d) {
+        size_t last = d.end[s.pc] - 1;
+        for (size_t address = s.pc; address < last; address++) {
+            d.steps[address](s);
+        }
+        s.pc = last;
+        d.steps[last](s);
+        leave(s, last, d);
+        return last;
+    }
+
+    // Ustawia pc po wykonaniu instrukcji spod adresu address. Skoki do etykiet
+    // zostawiają pc == address (Jcc przesuwa je, gdy nie skacze), a Ret
+    // i skoki pośrednie ustawiają pc same -- tu jest tylko sprawdzane.
+    constexpr static void leave(S &s, size_t address, const Dispatch &d) {
+        constexpr size_t none = sizeof...(Instructions);
+        switch (d.flow[address]) {
+            case Flow::Next:
+                s.pc = address + 1;
+                return;
+            case Flow::Branch:
+                if (s.pc != address) {
+                    return;
+                }
+                break;
+            case Flow::Jump:
+            case Flow::Call:
+                break;
+            case Flow::Return:
+                if (s.pc == 0 || s.pc > none || !d.call[s.pc - 1]) {
+                    throw std::invalid_argument(
+                            "Return target is not a return address");
+                }
+                return;
+            case Flow::Indirect:
+                if (s.pc >= none || !d.label[s.pc]) {
+                    throw std::invalid_argument("Jump target is not a label");
+                }
+                return;
+        }
+        if (d.target[address] == none) {
+            throw std::invalid_argument("Non-existent label");
+        }
+        s.pc = d.target[address];
     }
 };
 
 template <std::size_t memorySize, typename T>
 struct Computer {
 public:
-    static_assert(std::is_integral<T>(), "Not an integral type.");
+    static_assert(internal::IsWord<T>(), "Not an integral type.");
 
     template <typename ProgramIns>
     static constexpr std::array<T, memorySize> boot() {
-        static_assert(IsProgram<ProgramIns>(), "Not a valid program type.");
         State<memorySize, T> computerMemory;
+        execute<ProgramIns>(computerMemory);
+        return computerMemory.memoryBlocks;
+    }
+
+    // Uruchomienie programu z portami In/Out podpiętymi pod ports.
+    template <typename ProgramIns, typename Ports>
+    static constexpr std::array<T, memorySize> boot(Ports &ports) {
+        StreamState<memorySize, T, Ports> computerMemory(ports);
+        execute<ProgramIns>(computerMemory);
+        return computerMemory.memoryBlocks;
+    }
+
+private:
+    template <typename ProgramIns, typename S>
+    static constexpr void execute(S &computerMemory) {
+        static_assert(IsProgram<ProgramIns>(), "Not a valid program type.");
 
         // Deklaracja zmiennych -- zgodnie z poleceniem, mają być inicjalizowane
         // oddzielnie.
         InitialInstructionsParsing<
-                memorySize, T,
-                typename ProgramIns::Instructions>::evaluate(computerMemory);
+                S, typename ProgramIns::Instructions>::evaluate(computerMemory);
 
         // Rozpatrzenie pozostałych poleceń.
         InstructionsRunner<
-                memorySize, T, Label<0>, true, typename ProgramIns::Instructions,
-                typename ProgramIns::Instructions>::evaluate(computerMemory);
-
-        return computerMemory.memoryBlocks;
+                S, typename ProgramIns::Instructions>::evaluate(computerMemory);
     }
 };
 
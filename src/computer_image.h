@@ -0,0 +1,447 @@
+#ifndef ASSEMBLER_COMPUTER_IMAGE_H
+#define ASSEMBLER_COMPUTER_IMAGE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <iomanip>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "computer.h"
+
+// Pamięć po wykonaniu programu policzona raz i zapisana jako nagłówek.
+// Program generujący (po jednym na program, więc system budowania może je
+// uruchamiać równolegle) wywołuje BootCache<Computer<N, T>>::write<P>(ścieżka);
+// pozostałe jednostki dołączają wygenerowany nagłówek i wołają
+// BootCache<Computer<N, T>>::boot<P>(), które bez obrazu liczy wynik zwykłym
+// Computer::boot. Generatory buduje i uruchamia boot_images.sh.
+//
+// Każda jednostka wołająca boot<P>() musi dołączać te same nagłówki obrazów
+// i mieć to samo ASSEMBLER_ENGINE_HASH. Inaczej boot<P> ma w różnych
+// jednostkach różne definicje (z obrazem i bez), co łamie ODR, a linker nie
+// zgłasza błędu.
+//
+// Kluczem obrazu jest skrót opisu typu programu (nazw instrukcji i wartości
+// ich argumentów, niezależny od kompilatora), rozmiaru pamięci i typu słowa
+// oraz ASSEMBLER_ENGINE_HASH, który system budowania musi ustawiać na skrót
+// computer.h, żeby zmiana silnika unieważniała obrazy. Bez tego makra write
+// się nie kompiluje, a boot nie używa obrazów.
+//
+// Każdy typ występujący w programie potrzebuje klucza: instrukcje i operandy
+// z argumentami typowymi -- nazwy w OperationName, pozostałe -- własnej
+// specjalizacji TypeKey.
+
+// Obraz pamięci dla klucza; specjalizacje są generowane przez BootCache::write.
+// bits to kolejne słowa pamięci jako liczby bez znaku, po 64 bity, od
+// najmłodszych.
+template <uint64_t key>
+struct BootImage {
+    static constexpr bool cached = false;
+};
+
+namespace internal {
+#ifdef ASSEMBLER_ENGINE_HASH
+    constexpr bool engineHashSet = true;
+    constexpr uint64_t engineHash =
+            static_cast<uint64_t>(ASSEMBLER_ENGINE_HASH);
+#else
+    constexpr bool engineHashSet = false;
+    constexpr uint64_t engineHash = 0;
+#endif
+
+    // Zależne od parametru szablonu, żeby static_assert w write działał
+    // dopiero przy użyciu.
+    template <typename>
+    constexpr bool engineHashKnown = engineHashSet;
+
+    constexpr uint64_t fnvOffset = 0xcbf29ce484222325ull;
+    constexpr uint64_t fnvPrime = 0x100000001b3ull;
+
+    constexpr uint64_t fnv1a(const char *text, uint64_t hash) {
+        for (; *text != '\0'; text++) {
+            hash ^= static_cast<unsigned char>(*text);
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+    constexpr uint64_t fnv1a(uint64_t value, uint64_t hash) {
+        for (int i = 0; i < 8; i++) {
+            hash ^= (value >> (8 * i)) & 0xff;
+            hash *= fnvPrime;
+        }
+        return hash;
+    }
+
+    // Klucz węzła opisu: nazwa, liczba części i klucze części.
+    constexpr uint64_t nodeKey(const char *name,
+                               std::initializer_list<uint64_t> parts) {
+        uint64_t hash = fnv1a(name, fnvOffset);
+        hash = fnv1a(static_cast<uint64_t>(parts.size()), hash);
+        for (uint64_t part : parts) {
+            hash = fnv1a(part, hash);
+        }
+        return hash;
+    }
+
+    template <typename T>
+    constexpr std::size_t imageChunks = (sizeof(T) + 7) / 8;
+
+    template <typename T>
+    constexpr uint64_t wordKey() {
+        return nodeKey("word", {sizeof(T), isSigned<T>});
+    }
+
+    // Stała razem z typem, po 64 bity od najmłodszych.
+    template <typename T>
+    constexpr uint64_t valueKey(T value) {
+        auto bits = static_cast<Unsigned<T>>(value);
+        uint64_t hash = fnv1a(wordKey<T>(), fnvOffset);
+        for (std::size_t i = 0; i < imageChunks<T>; i++) {
+            hash = fnv1a(static_cast<uint64_t>(bits), hash);
+            if constexpr (imageChunks<T> > 1) {
+                bits >>= 64;
+            }
+        }
+        return hash;
+    }
+
+    template <typename T, std::size_t memorySize, typename Bits>
+    constexpr std::array<T, memorySize> unpackImage(const Bits &bits) {
+        using U = Unsigned<T>;
+        std::array<T, memorySize> memory{};
+        for (std::size_t i = 0; i < memorySize; i++) {
+            U value = 0;
+            for (std::size_t j = imageChunks<T>; j > 0; j--) {
+                if constexpr (imageChunks<T> > 1) {
+                    value <<= 64;
+                }
+                value |= static_cast<U>(bits[i * imageChunks<T> + j - 1]);
+            }
+            memory[i] = static_cast<T>(value);
+        }
+        return memory;
+    }
+};
+
+// Nazwy szablonów, których wszystkie argumenty są typami.
+template <template <typename...> class Op>
+struct OperationName;
+
+template <>
+struct OperationName<Program> {
+    static constexpr auto value = "Program";
+};
+
+template <>
+struct OperationName<Mov> {
+    static constexpr auto value = "Mov";
+};
+
+template <>
+struct OperationName<JmpInd> {
+    static constexpr auto value = "JmpInd";
+};
+
+template <>
+struct OperationName<Push> {
+    static constexpr auto value = "Push";
+};
+
+template <>
+struct OperationName<Pop> {
+    static constexpr auto value = "Pop";
+};
+
+template <>
+struct OperationName<Xchg> {
+    static constexpr auto value = "Xchg";
+};
+
+template <>
+struct OperationName<CmpXchg> {
+    static constexpr auto value = "CmpXchg";
+};
+
+template <>
+struct OperationName<FetchAdd> {
+    static constexpr auto value = "FetchAdd";
+};
+
+template <>
+struct OperationName<Add> {
+    static constexpr auto value = "Add";
+};
+
+template <>
+struct OperationName<Sub> {
+    static constexpr auto value = "Sub";
+};
+
+template <>
+struct OperationName<Adc> {
+    static constexpr auto value = "Adc";
+};
+
+template <>
+struct OperationName<Sbb> {
+    static constexpr auto value = "Sbb";
+};
+
+template <>
+struct OperationName<Inc> {
+    static constexpr auto value = "Inc";
+};
+
+template <>
+struct OperationName<Dec> {
+    static constexpr auto value = "Dec";
+};
+
+template <>
+struct OperationName<And> {
+    static constexpr auto value = "And";
+};
+
+template <>
+struct OperationName<Or> {
+    static constexpr auto value = "Or";
+};
+
+template <>
+struct OperationName<Not> {
+    static constexpr auto value = "Not";
+};
+
+template <>
+struct OperationName<Cmp> {
+    static constexpr auto value = "Cmp";
+};
+
+template <typename X>
+struct TypeKey {
+    static_assert(!std::is_same<X, X>::value,
+                  "No boot image key for this type.");
+};
+
+template <template <typename...> class Op, typename... Args>
+struct TypeKey<Op<Args...>> {
+    static constexpr uint64_t value = internal::nodeKey(
+            OperationName<Op>::value, {TypeKey<Args>::value...});
+};
+
+template <auto V>
+struct TypeKey<Num<V>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("Num", {internal::valueKey(V)});
+};
+
+template <typename Base, typename Index, std::ptrdiff_t scale,
+        std::ptrdiff_t offset>
+struct TypeKey<Mem<Base, Index, scale, offset>> {
+    static constexpr uint64_t value = internal::nodeKey("Mem",
+            {TypeKey<Base>::value, TypeKey<Index>::value,
+             static_cast<uint64_t>(scale), static_cast<uint64_t>(offset)});
+};
+
+template <uint64_t I>
+struct TypeKey<Lea<I>> {
+    static constexpr uint64_t value = internal::nodeKey("Lea", {I});
+};
+
+template <std::size_t I>
+struct TypeKey<Reg<I>> {
+    static constexpr uint64_t value = internal::nodeKey("Reg", {I});
+};
+
+template <uint64_t I>
+struct TypeKey<LabelAddr<I>> {
+    static constexpr uint64_t value = internal::nodeKey("LabelAddr", {I});
+};
+
+template <uint64_t I>
+struct TypeKey<Label<I>> {
+    static constexpr uint64_t value = internal::nodeKey("Label", {I});
+};
+
+template <uint64_t I>
+struct TypeKey<Jmp<I>> {
+    static constexpr uint64_t value = internal::nodeKey("Jmp", {I});
+};
+
+template <Cc cc, uint64_t I>
+struct TypeKey<Jcc<cc, I>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("Jcc", {static_cast<uint64_t>(cc), I});
+};
+
+template <typename Index, uint64_t... labels>
+struct TypeKey<JmpTable<Index, labels...>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("JmpTable", {TypeKey<Index>::value, labels...});
+};
+
+template <uint64_t I>
+struct TypeKey<Call<I>> {
+    static constexpr uint64_t value = internal::nodeKey("Call", {I});
+};
+
+template <>
+struct TypeKey<Ret> {
+    static constexpr uint64_t value = internal::nodeKey("Ret", {});
+};
+
+template <>
+struct TypeKey<Fence> {
+    static constexpr uint64_t value = internal::nodeKey("Fence", {});
+};
+
+template <uint64_t key, typename Value>
+struct TypeKey<D<key, Value>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("D", {key, TypeKey<Value>::value});
+};
+
+template <Cc cc, typename Dst, typename Src>
+struct TypeKey<CMov<cc, Dst, Src>> {
+    static constexpr uint64_t value = internal::nodeKey("CMov",
+            {static_cast<uint64_t>(cc), TypeKey<Dst>::value,
+             TypeKey<Src>::value});
+};
+
+template <typename Dst, std::size_t port>
+struct TypeKey<In<Dst, port>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("In", {TypeKey<Dst>::value, port});
+};
+
+template <std::size_t port, typename Src>
+struct TypeKey<Out<port, Src>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("Out", {port, TypeKey<Src>::value});
+};
+
+// Pułapka w programie rezydualnym (specialize.h); deklaracje takie same jak
+// tam, żeby ten nagłówek nie zależał od specjalizacji.
+namespace internal {
+    enum class Failure : uint8_t;
+
+    template <Failure failure>
+    struct Fail;
+};
+
+template <internal::Failure failure>
+struct TypeKey<internal::Fail<failure>> {
+    static constexpr uint64_t value =
+            internal::nodeKey("Fail", {static_cast<uint64_t>(failure)});
+};
+
+namespace internal {
+    template <std::size_t memorySize, typename T, typename ProgramIns>
+    constexpr uint64_t imageKey() {
+        return nodeKey("BootImage", {memorySize, wordKey<T>(),
+                                     TypeKey<ProgramIns>::value, engineHash});
+    }
+};
+
+template <typename Machine>
+struct BootCache;
+
+template <std::size_t memorySize, typename T>
+struct BootCache<Computer<memorySize, T>> {
+    template <typename ProgramIns>
+    static constexpr uint64_t key() {
+        return internal::imageKey<memorySize, T, ProgramIns>();
+    }
+
+    template <typename ProgramIns>
+    static constexpr std::array<T, memorySize> boot() {
+        using Image = BootImage<key<ProgramIns>()>;
+        if constexpr (internal::engineHashSet && Image::cached) {
+            return internal::unpackImage<T, memorySize>(Image::bits);
+        } else {
+            return Computer<memorySize, T>::template boot<ProgramIns>();
+        }
+    }
+
+    // Zapisuje obraz programu do path. Jeśli plik ma już obraz o tym samym
+    // kluczu, nie jest ruszany (ani jego czas modyfikacji), a program nie jest
+    // wykonywany; zwraca wtedy false.
+    template <typename ProgramIns>
+    static bool write(const std::string &path) {
+        static_assert(internal::engineHashKnown<ProgramIns>,
+                      "Define ASSEMBLER_ENGINE_HASH as a hash of computer.h.");
+        const std::string header = headerLine(key<ProgramIns>());
+        {
+            std::ifstream existing(path);
+            std::string line;
+            if (std::getline(existing, line) && line == header) {
+                return false;
+            }
+        }
+
+        auto memory = Computer<memorySize, T>::template boot<ProgramIns>();
+
+        std::ostringstream out;
+        std::ostringstream name;
+        name << std::hex << std::setfill('0') << std::setw(16)
+             << key<ProgramIns>();
+        out << header << "\n"
+            << "// Wygenerowane przez BootCache::write -- nie edytować.\n"
+            << "#ifndef ASSEMBLER_BOOT_IMAGE_" << name.str() << "\n"
+            << "#define ASSEMBLER_BOOT_IMAGE_" << name.str() << "\n\n"
+            << "#include \"computer_image.h\"\n\n"
+            << "template <>\n"
+            << "struct BootImage<0x" << name.str() << "ull> {\n"
+            << "    static constexpr bool cached = true;\n"
+            << "    static constexpr uint64_t bits[] = {";
+        out << std::hex;
+        size_t count = 0;
+        for (T word : memory) {
+            auto value = static_cast<internal::Unsigned<T>>(word);
+            for (size_t j = 0; j < internal::imageChunks<T>; j++) {
+                out << (count % 4 == 0 ? "\n            " : " ") << "0x"
+                    << static_cast<uint64_t>(value) << "ull,";
+                count++;
+                if constexpr (internal::imageChunks<T> > 1) {
+                    value >>= 64;
+                }
+            }
+        }
+        out << "\n            0};\n"
+            << "};\n\n"
+            << "#endif\n";
+
+        // Zapis do pliku tymczasowego i zamiana nazwy -- równolegle budowane
+        // jednostki nie zobaczą niepełnego nagłówka.
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::trunc);
+            file << out.str();
+            if (!file.flush()) {
+                throw std::runtime_error("Cannot write boot image " + temporary);
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            std::remove(temporary.c_str());
+            throw std::runtime_error("Cannot write boot image " + path);
+        }
+        return true;
+    }
+
+private:
+    static std::string headerLine(uint64_t imageKey) {
+        std::ostringstream line;
+        line << "// BootImage " << std::hex << std::setfill('0')
+             << std::setw(16) << imageKey;
+        return line.str();
+    }
+};
+
+#endif  // ASSEMBLER_COMPUTER_IMAGE_H
@@ -0,0 +1,13 @@
+// Jednostka dołączająca nagłówek zapisany przez BootCache::write; budowana
+// przez computer_image_test.sh z flagą wypisaną przez boot_images.sh.
+#include "computer_image_sum.h"
+#include "computer_image_sum_image.h"
+
+static_assert(BootImage<image_sum_cache::key<tmpasm_image_sum>()>::cached,
+              "Failed [image used].");
+static_assert(image_sum_cache::boot<tmpasm_image_sum>()[1] == 5050,
+              "Failed [image boot].");
+
+int main() {
+    return image_sum_cache::boot<tmpasm_image_sum>()[0] == 0 ? 0 : 1;
+}
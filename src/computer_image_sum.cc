@@ -0,0 +1,7 @@
+// Generator obrazu dla boot_images.sh.
+#include "computer_image_sum.h"
+
+int main(int, char **argv) {
+    image_sum_cache::write<tmpasm_image_sum>(argv[1]);
+    return 0;
+}
@@ -0,0 +1,18 @@
+#ifndef ASSEMBLER_COMPUTER_IMAGE_SUM_H
+#define ASSEMBLER_COMPUTER_IMAGE_SUM_H
+
+#include "computer_image.h"
+
+// Program wspólny dla generatora obrazu (computer_image_sum.cc) i jednostki,
+// która używa wygenerowanego nagłówka (computer_image_second_test.cc).
+using tmpasm_image_sum = Program<
+        D<Id("n"), Num<100>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jnz<Id("loop")>>;
+
+using image_sum_cache = BootCache<Computer<2, int>>;
+
+#endif  // ASSEMBLER_COMPUTER_IMAGE_SUM_H
@@ -0,0 +1,71 @@
+// Zwykle ustawiane przez system budowania na skrót computer.h.
+#define ASSEMBLER_ENGINE_HASH 0x1234
+
+#include "computer_image.h"
+#include "specialize.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using tmpasm_sum = Program<
+        D<Id("n"), Num<100>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jnz<Id("loop")>>;
+
+// Obraz wpisany ręcznie, różny od wyniku programu -- boot musi go użyć
+// zamiast wykonywać program.
+using tmpasm_cached = Program<Mov<Mem<Num<0>>, Num<1>>>;
+using cache = BootCache<Computer<2, int>>;
+
+template <>
+struct BootImage<cache::key<tmpasm_cached>()> {
+    static constexpr bool cached = true;
+    static constexpr uint64_t bits[] = {0x7, 0xffffffff, 0};
+};
+
+// Program rezydualny z pułapką (internal::Fail) też ma klucz.
+using tmpasm_trap = Program<Mov<Mem<Num<9>>, Num<1>>>;
+using trap_residual = Specialize<Computer<2, int>, tmpasm_trap>::type;
+using tmpasm_trap_id = Program<Mov<Mem<Lea<Id("x")>>, Num<1>>>;
+using trap_id_residual = Specialize<Computer<2, int>, tmpasm_trap_id>::type;
+
+int main() {
+    static_assert(cache::key<tmpasm_sum>() != cache::key<tmpasm_cached>(),
+                  "Failed [key].");
+    // Klucz zależy tylko od opisu programu, więc jest taki sam w każdym
+    // kompilatorze.
+    static_assert(cache::key<tmpasm_sum>() == 0x48ef43a253292340ull,
+                  "Failed [stable key].");
+    static_assert(cache::boot<tmpasm_sum>()[1] == 5050, "Failed [boot].");
+    static_assert(!std::is_same<trap_residual, tmpasm_trap>() &&
+                  cache::key<trap_residual>() != cache::key<tmpasm_trap>() &&
+                  cache::key<trap_residual>() != cache::key<trap_id_residual>(),
+                  "Failed [trap key].");
+    static_assert(cache::boot<tmpasm_cached>()[0] == 7 &&
+                  cache::boot<tmpasm_cached>()[1] == -1,
+                  "Failed [cached boot].");
+
+    const std::string path = "computer_image_test.out.h";
+    std::remove(path.c_str());
+    int failures = 0;
+    if (!cache::write<tmpasm_sum>(path)) {
+        std::cout << "Failed [write]." << std::endl;
+        failures++;
+    }
+    if (cache::write<tmpasm_sum>(path)) {
+        std::cout << "Failed [write unchanged]." << std::endl;
+        failures++;
+    }
+    std::ifstream image(path);
+    std::string contents((std::istreambuf_iterator<char>(image)),
+                         std::istreambuf_iterator<char>());
+    if (contents.find("0x0ull, 0x13baull,") == std::string::npos) {
+        std::cout << "Failed [image contents]." << std::endl;
+        failures++;
+    }
+    std::remove(path.c_str());
+    return failures == 0 ? 0 : 1;
+}
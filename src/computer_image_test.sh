@@ -0,0 +1,23 @@
+#!/bin/sh
+# Generuje obraz przez boot_images.sh, kompiluje z nim drugą jednostkę
+# i sprawdza, że ponowne uruchomienie nie zmienia nagłówka.
+# Uruchomienie: ./computer_image_test.sh, kompilator z CXX, domyślnie g++.
+set -e
+
+cxx=${CXX:-g++}
+here=$(cd "$(dirname "$0")" && pwd)
+work=$(mktemp -d)
+trap 'rm -rf "$work"' EXIT
+
+flag=$("$here/boot_images.sh" "$work/images" "$here/computer_image_sum.cc")
+"$cxx" -std=c++17 "$flag" -I"$here" -I"$work/images" -o "$work/second" \
+        "$here/computer_image_second_test.cc"
+"$work/second"
+
+touch "$work/mark"
+sleep 1
+"$here/boot_images.sh" "$work/images" "$here/computer_image_sum.cc" >/dev/null
+if [ -n "$(find "$work/images" -newer "$work/mark")" ]; then
+    echo "Failed [unchanged image rewritten]."
+    exit 1
+fi
@@ -44,4 +44,60 @@ int main() {
     using fail_undeclared_lea = Program<Mov<Lea<Id("a")>, Num<42>>>;
     test_machine::boot<fail_undeclared_lea>();
 
+    // Odwołania poza pamięć
+
+    using fail_out_of_range = Program<Mov<Mem<Num<4>>, Num<1>>>;
+    using fail_indexed_out_of_range = Program<Mov<Mem<Num<1>, Num<1>, 2, 1>, Num<1>>>;
+
+    constexpr auto out_of_range = test_machine::boot<fail_out_of_range>();
+    constexpr auto indexed_out_of_range =
+            test_machine::boot<fail_indexed_out_of_range>();
+
+    // Adres, który po obcięciu do słowa trafiłby w pamięć (256 -> 0,
+    // 255 + 2 -> 1), a naprawdę jest poza nią.
+    using byte_machine = Computer<4, uint8_t>;
+    using fail_wrapped_address = Program<Mov<Mem<Num<256>>, Num<1>>>;
+    using fail_wrapped_indexed = Program<Mov<Mem<Num<255>, Num<2>>, Num<1>>>;
+
+    constexpr auto wrapped_address = byte_machine::boot<fail_wrapped_address>();
+    constexpr auto wrapped_indexed = byte_machine::boot<fail_wrapped_indexed>();
+
+    // Przepełnienie i opróżnienie stosu
+
+    using fail_stack_overflow = Program<
+            D<Id("a"), Num<0>>,
+            Push<Num<1>>, Push<Num<2>>, Push<Num<3>>, Push<Num<4>>>;
+    using fail_stack_underflow = Program<Pop<Mem<Num<0>>>>;
+    using fail_ret_underflow = Program<Ret>;
+
+    // Wyjątek w czasie kompilacji jest błędem tylko w wyrażeniu stałym.
+    constexpr auto stack_overflow = test_machine::boot<fail_stack_overflow>();
+    constexpr auto stack_underflow = test_machine::boot<fail_stack_underflow>();
+    constexpr auto ret_underflow = test_machine::boot<fail_ret_underflow>();
+
+    // Ret tylko pod adres za instrukcją Call
+
+    using fail_ret_out_of_range = Program<Push<Num<-1>>, Ret>;
+    using fail_ret_target = Program<Push<Num<0>>, Ret, Label<Id("a")>>;
+
+    constexpr auto ret_out_of_range = test_machine::boot<fail_ret_out_of_range>();
+    constexpr auto ret_target = test_machine::boot<fail_ret_target>();
+
+    // Skoki pośrednie
+
+    using fail_jmp_table_index = Program<
+            JmpTable<Num<2>, Id("a"), Id("b")>,
+            Label<Id("a")>, Label<Id("b")>>;
+    using fail_jmp_ind_target = Program<JmpInd<Num<0>>, Label<Id("a")>>;
+
+    constexpr auto jmp_table_index = test_machine::boot<fail_jmp_table_index>();
+    constexpr auto jmp_ind_target = test_machine::boot<fail_jmp_ind_target>();
+
+    // Ta sama nazwa eksportowana przez dwa moduły
+
+    using fail_module_a = Module<Export<Id("f")>, Label<Id("f")>>;
+    using fail_module_b = Module<Export<Id("f")>, D<Id("f"), Num<0>>>;
+    using fail_duplicate_export = Link<fail_module_a, fail_module_b>;
+    test_machine::boot<fail_duplicate_export>();
+
 };
@@ -0,0 +1,223 @@
+#ifndef ASSEMBLER_MULTICORE_H
+#define ASSEMBLER_MULTICORE_H
+
+#include <array>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "computer.h"
+
+// Stan jednego rdzenia: własne flagi, rejestry, pc i stos, pamięć wspólna
+// z pozostałymi rdzeniami. Każdy rdzeń dostaje równy kawałek wolnej pamięci
+// (ponad zadeklarowanymi zmiennymi) na stos, licząc od końca pamięci.
+// W trybie równoległym operacje atomowe korzystają z wbudowanych __atomic,
+// zwykłe odczyty i zapisy nie są synchronizowane -- komórki zmieniane przez
+// kilka rdzeni naraz należy czytać i zapisywać instrukcjami atomowymi.
+template <std::size_t memorySize, typename T>
+struct CoreState {
+    using Word = T;
+    static constexpr std::size_t size = memorySize;
+
+    constexpr CoreState()
+            : zf(false),
+              sf(false),
+              cf(false),
+              of(false),
+              lf(false),
+              sp(0),
+              pc(0),
+              stackBase(0),
+              stackLimit(0),
+              parallel(false),
+              shared(nullptr),
+              registers() {}
+
+    bool zf;
+    bool sf;
+    bool cf;
+    bool of;
+    bool lf;
+    size_t sp;
+    size_t pc;
+    size_t stackBase;
+    size_t stackLimit;
+    bool parallel;
+    State<memorySize, T> *shared;
+    std::array<T, registerCount> registers;
+
+    constexpr T &memory(size_t addr) {
+        return shared->memory(addr);
+    }
+
+    constexpr const T &memory(size_t addr) const {
+        return std::as_const(*shared).memory(addr);
+    }
+
+    constexpr size_t lookup(uint64_t id) const {
+        return shared->lookup(id);
+    }
+
+    constexpr void push(T value) {
+        if (sp == stackLimit) {
+            throw std::invalid_argument("Stack overflow");
+        }
+        shared->memoryBlocks[--sp] = value;
+    }
+
+    constexpr T pop() {
+        if (sp == stackBase) {
+            throw std::invalid_argument("Stack underflow");
+        }
+        T value = shared->memoryBlocks[sp];
+        shared->memoryBlocks[sp++] = T();
+        return value;
+    }
+
+    constexpr T exchange(T &cell, T value) {
+        if (parallel) {
+            return __atomic_exchange_n(&cell, value, __ATOMIC_SEQ_CST);
+        }
+        return shared->exchange(cell, value);
+    }
+
+    constexpr bool compareExchange(T &cell, T &expected, T desired) {
+        if (parallel) {
+            return __atomic_compare_exchange_n(&cell, &expected, desired, false,
+                                               __ATOMIC_SEQ_CST,
+                                               __ATOMIC_SEQ_CST);
+        }
+        return shared->compareExchange(cell, expected, desired);
+    }
+
+    constexpr T fetchAdd(T &cell, T value) {
+        if (parallel) {
+            return __atomic_fetch_add(&cell, value, __ATOMIC_SEQ_CST);
+        }
+        return shared->fetchAdd(cell, value);
+    }
+
+    constexpr void fence() {
+        if (parallel) {
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        }
+    }
+};
+
+// MultiCore<Computer<N, T>, Cores, Programy...> -- po jednym programie na
+// rdzeń, wspólna pamięć. Deklaracje wszystkich programów trafiają do pamięci
+// w kolejności rdzeni i tworzą wspólną tablicę symboli; ten sam identyfikator
+// zadeklarowany przez dwa programy jest błędem.
+// interleave() wykonuje rdzenie na zmianę po jednej instrukcji (deterministycznie,
+// także w czasie kompilacji), run() uruchamia każdy rdzeń w osobnym wątku.
+template <typename Machine, std::size_t cores, typename... Programs>
+struct MultiCore;
+
+template <std::size_t memorySize, typename T, std::size_t cores,
+        typename... Programs>
+struct MultiCore<Computer<memorySize, T>, cores, Programs...> {
+    static_assert(cores > 0, "At least one core is required.");
+    static_assert(sizeof...(Programs) == cores, "Expected one program per core.");
+    static_assert((IsProgram<Programs>() && ...), "Not a valid program type.");
+
+    using Shared = State<memorySize, T>;
+    using Core = CoreState<memorySize, T>;
+    using Cores = std::array<Core, cores>;
+
+    static constexpr std::array<T, memorySize> interleave() {
+        using Step = bool (*)(Core &);
+        constexpr Step steps[] = {
+                &InstructionsRunner<Core,
+                        typename Programs::Instructions>::step...};
+
+        Shared shared;
+        Cores context = prepare(shared, false);
+        bool running = true;
+        while (running) {
+            running = false;
+            for (size_t core = 0; core < cores; core++) {
+                if (steps[core](context[core])) {
+                    running = true;
+                }
+            }
+        }
+        return shared.memoryBlocks;
+    }
+
+    static std::array<T, memorySize> run() {
+        Shared shared;
+        Cores context = prepare(shared, true);
+        std::array<std::exception_ptr, cores> errors;
+        std::array<std::thread, cores> threads;
+        start(context, errors, threads, std::index_sequence_for<Programs...>());
+        for (auto &thread : threads) {
+            thread.join();
+        }
+        for (auto &error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+        return shared.memoryBlocks;
+    }
+
+private:
+    static constexpr Cores prepare(Shared &shared, bool parallel) {
+        size_t declared = 0;
+        ((InitialInstructionsParsing<Shared,
+                typename Programs::Instructions>::evaluate(shared),
+          declared = checkDeclarations(shared, declared)), ...);
+
+        size_t stackSize = (memorySize - shared.decCount) / cores;
+        Cores context;
+        for (size_t core = 0; core < cores; core++) {
+            context[core].shared = &shared;
+            context[core].parallel = parallel;
+            context[core].stackBase = memorySize - core * stackSize;
+            context[core].stackLimit = context[core].stackBase - stackSize;
+            context[core].sp = context[core].stackBase;
+        }
+        return context;
+    }
+
+    // Zmienna zadeklarowana przez dwa programy byłaby po cichu wspólna
+    // (lookup zwraca pierwszą deklarację), a wartość początkowa z drugiego
+    // programu -- pominięta, więc to błąd. Sprawdza deklaracje od declared
+    // i zwraca nową liczbę deklaracji.
+    static constexpr size_t checkDeclarations(const Shared &shared,
+                                              size_t declared) {
+        for (size_t i = declared; i < shared.decCount; i++) {
+            for (size_t j = 0; j < declared; j++) {
+                if (shared.declarationIDs[i] == shared.declarationIDs[j]) {
+                    throw std::invalid_argument(
+                            "Variable declared by more than one core");
+                }
+            }
+        }
+        return shared.decCount;
+    }
+
+    template <typename ProgramIns>
+    static void runCore(Core &core, std::exception_ptr &error) {
+        try {
+            InstructionsRunner<Core,
+                    typename ProgramIns::Instructions>::evaluate(core);
+        } catch (...) {
+            error = std::current_exception();
+        }
+    }
+
+    template <size_t... core>
+    static void start(Cores &context,
+                      std::array<std::exception_ptr, cores> &errors,
+                      std::array<std::thread, cores> &threads,
+                      std::index_sequence<core...>) {
+        ((threads[core] = std::thread(&runCore<Programs>, std::ref(context[core]),
+                                      std::ref(errors[core]))), ...);
+    }
+};
+
+#endif  // ASSEMBLER_MULTICORE_H
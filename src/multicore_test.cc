@@ -0,0 +1,97 @@
+#include "multicore.h"
+#include <array>
+#include <iostream>
+
+// Dwa rdzenie zwiększają wspólny licznik -- atomowo przez FetchAdd oraz pod
+// blokadą zdobywaną przez CmpXchg i zwalnianą przez Xchg.
+
+using counter_core0 = Program<
+        D<Id("cnt"), Num<0>>,
+        D<Id("n0"), Num<1000>>,
+        D<Id("t0"), Num<0>>,
+        Label<Id("loop")>,
+        Mov<Mem<Lea<Id("t0")>>, Num<1>>,
+        FetchAdd<Mem<Lea<Id("cnt")>>, Mem<Lea<Id("t0")>>>,
+        Dec<Mem<Lea<Id("n0")>>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+using counter_core1 = Program<
+        D<Id("n1"), Num<1000>>,
+        D<Id("t1"), Num<0>>,
+        Label<Id("loop")>,
+        Mov<Mem<Lea<Id("t1")>>, Num<1>>,
+        FetchAdd<Mem<Lea<Id("cnt")>>, Mem<Lea<Id("t1")>>>,
+        Dec<Mem<Lea<Id("n1")>>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+using counter = MultiCore<Computer<8, int>, 2, counter_core0, counter_core1>;
+
+template <uint64_t n, uint64_t e, uint64_t r>
+using locked_core = Program<
+        D<n, Num<500>>,
+        D<e, Num<0>>,
+        D<r, Num<0>>,
+        Label<Id("loop")>,
+        Label<Id("spin")>,
+        Mov<Mem<Lea<e>>, Num<0>>,
+        CmpXchg<Mem<Lea<Id("lock")>>, Mem<Lea<e>>, Num<1>>,
+        Jz<Id("got")>,
+        Jmp<Id("spin")>,
+        Label<Id("got")>,
+        Inc<Mem<Lea<Id("sum")>>>,
+        Mov<Mem<Lea<r>>, Num<0>>,
+        Fence,
+        Xchg<Mem<Lea<Id("lock")>>, Mem<Lea<r>>>,
+        Dec<Mem<Lea<n>>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+using locked = MultiCore<Computer<16, int>, 2,
+        Program<D<Id("lock"), Num<0>>, D<Id("sum"), Num<0>>>,
+        locked_core<Id("n1"), Id("e1"), Id("r1")>>;
+
+using locked_sum = MultiCore<Computer<16, int>, 3,
+        Program<D<Id("lock"), Num<0>>, D<Id("sum"), Num<0>>>,
+        locked_core<Id("n1"), Id("e1"), Id("r1")>,
+        locked_core<Id("n2"), Id("e2"), Id("r2")>>;
+
+// Oba rdzenie deklarują własny licznik n.
+using same_counter = Program<
+        D<Id("n"), Num<10>>,
+        Label<Id("loop")>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jnz<Id("loop")>>;
+
+using duplicated = MultiCore<Computer<8, int>, 2, same_counter, same_counter>;
+
+int main() {
+    static_assert(counter::interleave()[0] == 2000, "Failed [counter].");
+    static_assert(locked::interleave()[1] == 500, "Failed [locked].");
+    static_assert(locked_sum::interleave()[1] == 1000, "Failed [locked_sum].");
+
+    int failures = 0;
+    for (int i = 0; i < 20; i++) {
+        if (counter::run()[0] != 2000) {
+            std::cout << "Failed [counter::run]." << std::endl;
+            failures++;
+        }
+        auto memory = locked_sum::run();
+        if (memory[0] != 0 || memory[1] != 1000) {
+            std::cout << "Failed [locked_sum::run]." << std::endl;
+            failures++;
+        }
+    }
+
+    try {
+        duplicated::run();
+        std::cout << "Failed [duplicated]." << std::endl;
+        failures++;
+    } catch (const std::invalid_argument &) {
+    }
+    return failures == 0 ? 0 : 1;
+}
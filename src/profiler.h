@@ -0,0 +1,244 @@
+#ifndef ASSEMBLER_PROFILER_H
+#define ASSEMBLER_PROFILER_H
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "computer.h"
+
+// Profiler próbkujący dla wykonania w czasie działania programu. Co period
+// instrukcji odczytywany jest licznik cykli, a cykle od poprzedniej próbki są
+// przypisywane bieżącemu stosowi wywołań: etykietom, w których obszarze
+// wykonano kolejne Call, i etykiecie obszaru bieżącej instrukcji. Obszar
+// instrukcji to ostatnia etykieta przed nią w programie. Wynik jest w formacie
+// "folded stacks" (obszar;obszar;obszar wartość), czytanym przez flamegraph.pl
+// i podobne narzędzia.
+//
+// Zwykłe InstructionsRunner i Computer::boot nie mają żadnych punktów
+// zaczepienia, więc profiler nic nie kosztuje, gdy nie jest używany.
+// Z -DASSEMBLER_NO_PROFILE Profile::boot i ProfiledRunner wykonują program
+// zwykłym InstructionsRunner, bez próbkowania.
+namespace internal {
+#ifdef ASSEMBLER_NO_PROFILE
+    constexpr bool profilingEnabled = false;
+#else
+    constexpr bool profilingEnabled = true;
+#endif
+
+    // Licznik cykli procesora, a bez niego zegar monotoniczny w nanosekundach.
+    struct CycleClock {
+        static uint64_t now() {
+#if defined(__x86_64__) || defined(__i386__)
+            return __rdtsc();
+#else
+            return static_cast<uint64_t>(
+                    std::chrono::duration_cast<std::chrono::nanoseconds>(
+                            std::chrono::steady_clock::now().time_since_epoch())
+                            .count());
+#endif
+        }
+    };
+
+    // Obszar bez etykiety -- początek programu.
+    constexpr uint64_t noRegion = ~uint64_t(0);
+
+    // Nazwa identyfikatora z Id(); wielkość liter i wiodące 'a' giną przy
+    // kodowaniu. Identyfikatory lokalne modułu dostają przyrostek @zakres.
+    inline std::string idName(uint64_t id) {
+        if (id == noRegion) {
+            return "(start)";
+        }
+        std::string name;
+        for (int shift = 40; shift >= 0; shift -= 8) {
+            auto c = static_cast<uint8_t>(id >> shift);
+            if (c == 0 && name.empty()) continue;
+            if (c < 26) {
+                name += static_cast<char>('a' + c);
+            } else if (c >= static_cast<uint8_t>('0' - 'A') &&
+                       c <= static_cast<uint8_t>('9' - 'A')) {
+                name += static_cast<char>(c + 'A');
+            } else {
+                name += '?';
+            }
+        }
+        if (name.empty()) {
+            name = "a";
+        }
+        uint64_t scope = id >> 48;
+        if (scope != 0) {
+            name += "@" + std::to_string(scope);
+        }
+        return name;
+    }
+};
+
+// Obszar etykiety dla każdego adresu programu.
+template <typename Instructions>
+struct LabelRegions;
+
+template <typename... Instructions>
+struct LabelRegions<std::tuple<Instructions...>> {
+    static constexpr size_t size = sizeof...(Instructions);
+
+    static constexpr std::array<uint64_t, size + 1> build() {
+        constexpr bool isLabel[] = {LabelId<Instructions>::isLabel..., false};
+        constexpr uint64_t ids[] = {LabelId<Instructions>::id..., 0};
+        std::array<uint64_t, size + 1> region{};
+        uint64_t current = internal::noRegion;
+        for (size_t i = 0; i < size; i++) {
+            if (isLabel[i]) {
+                current = ids[i];
+            }
+            region[i] = current;
+        }
+        region[size] = current;
+        return region;
+    }
+
+    static constexpr std::array<uint64_t, size + 1> region = build();
+};
+
+template <typename Clock = internal::CycleClock>
+class SamplingProfiler {
+public:
+    explicit SamplingProfiler(size_t period) : every(period) {
+        if (period == 0) {
+            throw std::invalid_argument("Empty sampling period");
+        }
+    }
+
+    // Wywoływane przez ProfiledRunner.
+    void start() {
+        last = Clock::now();
+    }
+
+    void enter(uint64_t callSite) {
+        calls.push_back(callSite);
+    }
+
+    void leave() {
+        // Ret bez Call (np. przez adres powrotu odłożony przez Push) nie zmienia
+        // stosu wywołań.
+        if (!calls.empty()) {
+            calls.pop_back();
+        }
+    }
+
+    size_t period() const {
+        return every;
+    }
+
+    // Próbka: cykle od poprzedniej próbki trafiają do stosu wywołań
+    // zakończonego obszarem region.
+    void sample(uint64_t region) {
+        uint64_t now = Clock::now();
+        calls.push_back(region);
+        stacks[calls] += now - last;
+        calls.pop_back();
+        last = now;
+        count++;
+    }
+
+    uint64_t samples() const {
+        return count;
+    }
+
+    void writeFolded(std::ostream &out) const {
+        for (const auto &[stack, weight] : stacks) {
+            for (size_t i = 0; i < stack.size(); i++) {
+                out << (i > 0 ? ";" : "") << internal::idName(stack[i]);
+            }
+            out << " " << weight << "\n";
+        }
+    }
+
+private:
+    size_t every;
+    uint64_t last = 0;
+    uint64_t count = 0;
+    std::vector<uint64_t> calls;
+    std::map<std::vector<uint64_t>, uint64_t> stacks;
+};
+
+// Wykonanie blokami przez InstructionsRunner::runBlock. Licznik do następnej
+// próbki jest lokalny i zmniejszany o długość bloku; profiler jest wołany
+// tylko przy próbce oraz na końcu bloków zakończonych Call albo Ret (stos
+// wywołań profilera).
+template <typename S, typename InstructionsOrigin>
+struct ProfiledRunner;
+
+template <typename S, typename... Instructions>
+struct ProfiledRunner<S, std::tuple<Instructions...>> {
+    using Origin = std::tuple<Instructions...>;
+
+    enum Kind : uint8_t { Other, CallSite, Return };
+
+    static constexpr Kind kinds[] = {
+            (IsCall<Instructions>::value ? CallSite
+             : std::is_same<Instructions, Ret>::value ? Return
+                                                      : Other)...,
+            Other};
+
+    template <typename Profiler>
+    static void evaluate(S &s, Profiler &profiler) {
+        if constexpr (!internal::profilingEnabled) {
+            InstructionsRunner<S, Origin>::evaluate(s);
+        } else {
+            using Runner = InstructionsRunner<S, Origin>;
+            constexpr auto &region = LabelRegions<Origin>::region;
+
+            const size_t period = profiler.period();
+            size_t left = period;
+            profiler.start();
+            while (s.pc < sizeof...(Instructions)) {
+                size_t first = s.pc;
+                size_t last = Runner::runBlock(s);
+                size_t executed = last - first + 1;
+                if (executed < left) {
+                    left -= executed;
+                } else {
+                    left = period - (executed - left) % period;
+                    profiler.sample(region[last]);
+                }
+                if (kinds[last] == CallSite) {
+                    profiler.enter(region[last]);
+                } else if (kinds[last] == Return) {
+                    profiler.leave();
+                }
+            }
+        }
+    }
+};
+
+template <typename Machine>
+struct Profile;
+
+template <std::size_t memorySize, typename T>
+struct Profile<Computer<memorySize, T>> {
+    template <typename ProgramIns, typename Profiler>
+    static std::array<T, memorySize> boot(Profiler &profiler) {
+        static_assert(IsProgram<ProgramIns>(), "Not a valid program type.");
+        using Instructions = typename ProgramIns::Instructions;
+
+        State<memorySize, T> computerMemory;
+        InitialInstructionsParsing<State<memorySize, T>,
+                Instructions>::evaluate(computerMemory);
+        ProfiledRunner<State<memorySize, T>, Instructions>::evaluate(
+                computerMemory, profiler);
+        return computerMemory.memoryBlocks;
+    }
+};
+
+#endif  // ASSEMBLER_PROFILER_H
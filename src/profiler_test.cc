@@ -0,0 +1,73 @@
+#include "profiler.h"
+#include <iostream>
+#include <sstream>
+
+// Rekurencja przez Call/Ret: f woła siebie, dopóki n > 0.
+using tmpasm_recursion = Program<
+        D<Id("n"), Num<3>>,
+        D<Id("s"), Num<0>>,
+        Call<Id("f")>,
+        Jmp<Id("end")>,
+        Label<Id("f")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jz<Id("ret")>,
+        Call<Id("f")>,
+        Label<Id("ret")>,
+        Ret,
+        Label<Id("end")>>;
+
+// Zegar przesuwany o 1 przy każdym odczycie -- waga stosu to liczba próbek.
+struct TickClock {
+    static uint64_t now() {
+        return ++ticks;
+    }
+    static inline uint64_t ticks = 0;
+};
+
+int main() {
+    int failures = 0;
+
+    SamplingProfiler<TickClock> every(1);
+    auto memory = Profile<Computer<64, int>>::boot<tmpasm_recursion>(every);
+    if (memory != Computer<64, int>::boot<tmpasm_recursion>()) {
+        std::cout << "Failed [result]." << std::endl;
+        failures++;
+    }
+    std::ostringstream folded;
+    every.writeFolded(folded);
+    if (folded.str() != "end 1\n"
+                        "(start) 2\n"
+                        "(start);f 2\n"
+                        "(start);f;f 2\n"
+                        "(start);f;f;f 1\n"
+                        "(start);f;f;ret 1\n"
+                        "(start);f;ret 1\n"
+                        "(start);ret 1\n") {
+        std::cout << "Failed [folded]." << std::endl << folded.str();
+        failures++;
+    }
+
+    // 25 instrukcji (razem z etykietami), próbka co 4.
+    SamplingProfiler<TickClock> sparse(4);
+    Profile<Computer<64, int>>::boot<tmpasm_recursion>(sparse);
+    if (every.samples() != 11 || sparse.samples() != 6) {
+        std::cout << "Failed [samples]." << std::endl;
+        failures++;
+    }
+
+    if (internal::idName(Id("loop")) != "loop" ||
+        internal::idName(internal::scopedId(2, Id("x1"))) != "x1@2") {
+        std::cout << "Failed [names]." << std::endl;
+        failures++;
+    }
+
+    try {
+        SamplingProfiler<TickClock> empty(0);
+        std::cout << "Failed [empty period]." << std::endl;
+        failures++;
+    } catch (const std::invalid_argument &) {
+    }
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,112 @@
+#ifndef ASSEMBLER_SCHEDULER_H
+#define ASSEMBLER_SCHEDULER_H
+
+#include <cstddef>
+#include <deque>
+#include <exception>
+#include <stdexcept>
+
+#include "computer.h"
+
+// Kooperacyjny planista wielu maszyn Computer<N, T> w jednym wątku.
+// Każda maszyna to zadanie ze stanem State (pamięć, flagi, stos, pc), które
+// dostaje po kolei przydział budget instrukcji. Zadanie jest przerywane na
+// granicy instrukcji i wznawiane od zapisanego pc, bez kopiowania pamięci.
+template <std::size_t memorySize, typename T>
+class Scheduler {
+public:
+    using Machine = State<memorySize, T>;
+
+    explicit Scheduler(size_t budget) : budget(budget) {
+        if (budget == 0) {
+            throw std::invalid_argument("Empty time slice");
+        }
+    }
+
+    // Tworzy maszynę z programem ProgramIns i zwraca jej numer.
+    template <typename ProgramIns>
+    size_t spawn() {
+        static_assert(IsProgram<ProgramIns>(), "Not a valid program type.");
+        using Instructions = typename ProgramIns::Instructions;
+
+        tasks.push_back(Task{Machine(),
+                             &InstructionsRunner<Machine, Instructions>::run,
+                             nullptr, false});
+        size_t id = tasks.size() - 1;
+        try {
+            InitialInstructionsParsing<Machine, Instructions>::evaluate(
+                    tasks[id].machine);
+            ready.push_back(id);
+        } catch (...) {
+            finish(id, std::current_exception());
+        }
+        return id;
+    }
+
+    // Jedna runda: każda gotowa maszyna wykonuje co najwyżej budget
+    // instrukcji. Zwraca liczbę maszyn, które nadal pracują.
+    size_t runSlice() {
+        for (size_t round = ready.size(); round > 0; round--) {
+            size_t id = ready.front();
+            ready.pop_front();
+            Task &task = tasks[id];
+            size_t executed;
+            try {
+                executed = task.run(task.machine, budget);
+            } catch (...) {
+                finish(id, std::current_exception());
+                continue;
+            }
+            // Niewykorzystany przydział oznacza, że program się zakończył.
+            if (executed == budget) {
+                ready.push_back(id);
+            } else {
+                finish(id, nullptr);
+            }
+        }
+        return ready.size();
+    }
+
+    void runUntilIdle() {
+        while (runSlice() > 0) {
+        }
+    }
+
+    const Machine &machine(size_t id) const {
+        return tasks.at(id).machine;
+    }
+
+    bool finished(size_t id) const {
+        return tasks.at(id).finished;
+    }
+
+    // Wyjątek, którym zakończyła się maszyna, albo nullptr.
+    std::exception_ptr error(size_t id) const {
+        return tasks.at(id).error;
+    }
+
+    size_t running() const {
+        return ready.size();
+    }
+
+private:
+    using Run = size_t (*)(Machine &, size_t);
+
+    struct Task {
+        Machine machine;
+        Run run;
+        std::exception_ptr error;
+        bool finished;
+    };
+
+    void finish(size_t id, std::exception_ptr error) {
+        tasks[id].finished = true;
+        tasks[id].error = error;
+    }
+
+    size_t budget;
+    std::deque<Task> tasks;
+    std::deque<size_t> ready;
+};
+
+#endif  // ASSEMBLER_SCHEDULER_H
@@ -0,0 +1,50 @@
+#include "scheduler.h"
+#include <iostream>
+
+// Każda maszyna liczy sumę 1 + 2 + ... + n dla innego n.
+template <int n>
+using tmpasm_sum = Program<
+        D<Id("n"), Num<n>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+using tmpasm_fail = Program<Pop<Mem<Num<0>>>>;
+
+int main() {
+    const size_t machines = 100000;
+    Scheduler<4, int> scheduler(7);
+
+    for (size_t i = 0; i < machines; i++) {
+        switch (i % 3) {
+            case 0: scheduler.spawn<tmpasm_sum<10>>(); break;
+            case 1: scheduler.spawn<tmpasm_sum<100>>(); break;
+            default: scheduler.spawn<tmpasm_fail>(); break;
+        }
+    }
+
+    // Po jednej rundzie każda maszyna wykonała co najwyżej 7 instrukcji.
+    scheduler.runSlice();
+    bool ok = scheduler.machine(0).memoryBlocks[1] <= 10 + 9 &&
+              scheduler.machine(1).memoryBlocks[1] <= 100 + 99;
+
+    scheduler.runUntilIdle();
+    for (size_t i = 0; ok && i < machines; i++) {
+        ok = scheduler.finished(i);
+        switch (i % 3) {
+            case 0: ok = ok && scheduler.machine(i).memoryBlocks[1] == 55; break;
+            case 1: ok = ok && scheduler.machine(i).memoryBlocks[1] == 5050; break;
+            default: ok = ok && scheduler.error(i) != nullptr; break;
+        }
+    }
+
+    if (!ok) {
+        std::cout << "Failed [scheduler]." << std::endl;
+        return 1;
+    }
+    return 0;
+}
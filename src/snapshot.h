@@ -0,0 +1,404 @@
+#ifndef ASSEMBLER_SNAPSHOT_H
+#define ASSEMBLER_SNAPSHOT_H
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "computer.h"
+#include "streams.h"
+
+// Zapis i odtworzenie pełnego stanu maszyny (pamięć, tablica symboli, flagi,
+// rejestry, sp i pc). Snapshot<N, T>(ścieżka, klucz programu) otwiera plik
+// zrzutu i daje stan do wykonywania: odtworzony z pliku, jeśli jest w nim
+// zapisany, albo pusty. save() zapisuje bieżący stan.
+//
+// Plik to strona nagłówków, a za nią dwa miejsca na stan skopiowany bajt
+// w bajt, od granicy strony. Każdy zapis trafia do miejsca starszego zrzutu
+// i dopiero na końcu, po zapisaniu danych na dysk, dostaje nagłówek z wyższym
+// numerem -- przerwany zapis zostawia poprzedni zrzut nietknięty. Odtworzenie
+// to jedno mmap z kopiowaniem przy zapisie -- strony są czytane dopiero przy
+// pierwszym dostępie, więc nie zależy od memorySize.
+//
+// Stan (SnapshotState) zapamiętuje strony zmienione przez zapisy do pamięci,
+// push i deklaracje, więc zapis nie porównuje ani nie czyta całego stanu.
+// Do miejsca zapisu trafiają strony zmienione od poprzedniego zapisu i te,
+// których temu miejscu brakuje od zapisu przedostatniego.
+//
+// Format zależy od typu słowa, rozmiaru pamięci i rozmiaru strony, które są
+// zapisane w nagłówku i sprawdzane przy odczycie. Tak samo sprawdzany jest
+// klucz programu: pc i adresy powrotu na stosie mają sens tylko w programie,
+// który zapisał stan. Kluczem może być np. TypeKey<P>::value
+// z computer_image.h.
+namespace internal {
+    constexpr uint32_t snapshotVersion = 3;
+    constexpr char snapshotMagic[8] = {'T', 'M', 'P', 'A', 'S', 'M', 'S', 'S'};
+    // Nagłówki miejsc leżą w osobnych sektorach strony nagłówków.
+    constexpr size_t snapshotHeaderSlot = 512;
+
+    struct SnapshotHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t complete;
+        // Numer zapisu; odtwarzany jest pełny zrzut o najwyższym numerze.
+        uint64_t sequence;
+        uint64_t pageSize;
+        uint64_t memorySize;
+        uint64_t wordSize;
+        uint64_t stateSize;
+        uint64_t program;
+        // Skrót poprzednich pól -- rozerwany zapis nagłówka nie przejdzie.
+        uint64_t checksum;
+    };
+
+    inline uint64_t headerChecksum(const SnapshotHeader &header) {
+        const auto *bytes = reinterpret_cast<const unsigned char *>(&header);
+        uint64_t hash = 0xcbf29ce484222325ull;
+        for (size_t i = 0; i < offsetof(SnapshotHeader, checksum); i++) {
+            hash ^= bytes[i];
+            hash *= 0x100000001b3ull;
+        }
+        return hash;
+    }
+
+    inline size_t pageSize() {
+        return static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+    }
+
+    inline void writeAll(int fd, const void *data, size_t bytes, off_t offset) {
+        const char *from = static_cast<const char *>(data);
+        while (bytes > 0) {
+            ssize_t done = ::pwrite(fd, from, bytes, offset);
+            if (done < 0) {
+                if (errno == EINTR) continue;
+                throwSystemError("pwrite");
+            }
+            from += done;
+            bytes -= static_cast<size_t>(done);
+            offset += done;
+        }
+    }
+
+    // Strony stanu zmienione od ostatniego zapisu (dirty) i strony, których
+    // brakuje w miejscu następnego zapisu (stale), po bicie na stronę.
+    class DirtyPages {
+    public:
+        DirtyPages(size_t page, size_t count)
+                : shift(0), words((count + 63) / 64), pageCount(count),
+                  dirty(words), stale(words) {
+            while ((size_t(1) << shift) < page) {
+                shift++;
+            }
+        }
+
+        void mark(size_t offset) {
+            size_t index = offset >> shift;
+            dirty[index / 64] |= uint64_t(1) << (index % 64);
+        }
+
+        void markRange(size_t begin, size_t end) {
+            for (size_t offset = begin; offset < end;
+                 offset += size_t(1) << shift) {
+                mark(offset);
+            }
+            if (begin < end) {
+                mark(end - 1);
+            }
+        }
+
+        void markAllStale() {
+            std::fill(stale.begin(), stale.end(), ~uint64_t(0));
+        }
+
+        bool needed(size_t index) const {
+            return ((dirty[index / 64] | stale[index / 64]) >> (index % 64)) &
+                   1;
+        }
+
+        size_t count() const {
+            return pageCount;
+        }
+
+        // Po udanym zapisie: miejscu poprzedniego zrzutu brakuje teraz stron
+        // zmienionych od tamtego zapisu.
+        void saved() {
+            stale.swap(dirty);
+            std::fill(dirty.begin(), dirty.end(), 0);
+        }
+
+    private:
+        size_t shift;
+        size_t words;
+        size_t pageCount;
+        std::vector<uint64_t> dirty;
+        std::vector<uint64_t> stale;
+    };
+};
+
+// Stan maszyny zapamiętujący zmienione strony. Odczyty pamięci idą przez
+// const memory i stron nie oznaczają.
+template <std::size_t memorySize, typename T>
+struct SnapshotState : public State<memorySize, T> {
+    using Base = State<memorySize, T>;
+
+    // Ustawiane przez Snapshot; bez niego zmiany nie są śledzone.
+    internal::DirtyPages *tracker = nullptr;
+
+    T &memory(size_t addr) {
+        T &cell = Base::memory(addr);
+        touch(&cell);
+        return cell;
+    }
+
+    const T &memory(size_t addr) const {
+        return Base::memory(addr);
+    }
+
+    void push(T value) {
+        Base::push(value);
+        touch(&this->memoryBlocks[this->sp]);
+    }
+
+    // Zdjęty element jest zerowany.
+    T pop() {
+        size_t at = this->sp;
+        T value = Base::pop();
+        touch(&this->memoryBlocks[at]);
+        return value;
+    }
+
+    void declare(uint64_t id, T value) {
+        size_t at = this->decCount;
+        Base::declare(id, value);
+        touch(&this->declarationIDs[at]);
+        touch(&this->memoryBlocks[at]);
+    }
+
+    // Położenie pola w stanie, w bajtach.
+    size_t offsetOf(const void *field) const {
+        return static_cast<size_t>(static_cast<const char *>(field) -
+                                   reinterpret_cast<const char *>(this));
+    }
+
+private:
+    void touch(const void *field) {
+        if (tracker != nullptr) {
+            tracker->mark(offsetOf(field));
+        }
+    }
+};
+
+template <std::size_t memorySize, typename T>
+class Snapshot {
+public:
+    using Machine = SnapshotState<memorySize, T>;
+
+    static_assert(std::is_trivially_copyable<Machine>(),
+                  "Machine state must be trivially copyable.");
+    static_assert(sizeof(internal::SnapshotHeader) <=
+                          internal::snapshotHeaderSlot,
+                  "Snapshot header does not fit its slot.");
+
+    // Otwiera albo tworzy zrzut programu o kluczu program w path. Stan jest
+    // odtwarzany z najnowszego pełnego zrzutu; bez niego (np. nowy plik) jest
+    // pusty i restored() zwraca false.
+    Snapshot(const std::string &path, uint64_t program)
+            : program(program), page(internal::pageSize()),
+              statePages((sizeof(Machine) + page - 1) / page),
+              pages(page, statePages) {
+        if (page < internal::snapshotHeaderSlot * 2) {
+            throw std::invalid_argument("Unsupported page size");
+        }
+        fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd < 0) {
+            internal::throwSystemError("open " + path);
+        }
+        try {
+            open(path);
+        } catch (...) {
+            if (mapped != nullptr) {
+                ::munmap(mapped, statePages * page);
+            }
+            ::close(fd);
+            throw;
+        }
+        machine->tracker = &pages;
+        // Drugie miejsce w pliku nie ma nic wspólnego ze stanem.
+        pages.markAllStale();
+    }
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    ~Snapshot() {
+        ::munmap(mapped, statePages * page);
+        ::close(fd);
+    }
+
+    Machine &state() {
+        return *machine;
+    }
+
+    bool restored() const {
+        return restoredState;
+    }
+
+    // Zapisuje stan i zwraca liczbę zapisanych stron stanu.
+    size_t save() {
+        // Pola poza pamięcią i tablicą symboli (flagi, sp, pc, rejestry)
+        // są zmieniane bez śledzenia, więc ich strony idą zawsze.
+        pages.markRange(0, machine->offsetOf(&machine->memoryBlocks));
+        pages.markRange(machine->offsetOf(&machine->decCount), sizeof(Machine));
+
+        const size_t target = current == 0 ? 1 : 0;
+        const char *data = reinterpret_cast<const char *>(machine);
+        size_t written = 0;
+        for (size_t i = 0; i < statePages; i++) {
+            if (!pages.needed(i)) continue;
+            size_t offset = i * page;
+            internal::writeAll(fd, data + offset,
+                               std::min(page, sizeof(Machine) - offset),
+                               static_cast<off_t>(slotOffset(target) + offset));
+            written++;
+        }
+        sync();
+
+        internal::SnapshotHeader header = makeHeader(sequence + 1);
+        internal::writeAll(fd, &header, sizeof(header),
+                           static_cast<off_t>(target *
+                                              internal::snapshotHeaderSlot));
+        sync();
+
+        current = static_cast<int>(target);
+        sequence++;
+        pages.saved();
+        return written;
+    }
+
+private:
+    size_t fileSize() const {
+        return page + 2 * statePages * page;
+    }
+
+    size_t slotOffset(size_t slot) const {
+        return page + slot * statePages * page;
+    }
+
+    void sync() {
+        if (::fdatasync(fd) < 0) {
+            internal::throwSystemError("fdatasync");
+        }
+    }
+
+    void open(const std::string &path) {
+        struct stat info {};
+        if (::fstat(fd, &info) < 0) {
+            internal::throwSystemError("fstat " + path);
+        }
+        if (info.st_size != 0 &&
+            static_cast<size_t>(info.st_size) != fileSize()) {
+            throw std::invalid_argument("Incompatible snapshot");
+        }
+        if (info.st_size != 0) {
+            findCurrent(path);
+        } else if (::ftruncate(fd, static_cast<off_t>(fileSize())) < 0) {
+            internal::throwSystemError("ftruncate " + path);
+        }
+
+        if (current >= 0) {
+            mapped = ::mmap(nullptr, statePages * page, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE, fd,
+                            static_cast<off_t>(slotOffset(current)));
+        } else {
+            mapped = ::mmap(nullptr, statePages * page, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        }
+        if (mapped == MAP_FAILED) {
+            mapped = nullptr;
+            internal::throwSystemError("mmap " + path);
+        }
+        if (current >= 0) {
+            restoredState = true;
+            machine = std::launder(reinterpret_cast<Machine *>(mapped));
+        } else {
+            machine = new (mapped) Machine();
+        }
+    }
+
+    // Najnowszy pełny zrzut. Plik właściwej wielkości bez pełnego zrzutu
+    // to przerwany pierwszy zapis -- stan jest wtedy pusty.
+    void findCurrent(const std::string &path) {
+        for (size_t slot = 0; slot < 2; slot++) {
+            internal::SnapshotHeader header{};
+            ssize_t done = ::pread(
+                    fd, &header, sizeof(header),
+                    static_cast<off_t>(slot * internal::snapshotHeaderSlot));
+            if (done < 0) {
+                internal::throwSystemError("pread " + path);
+            }
+            if (static_cast<size_t>(done) != sizeof(header) ||
+                std::memcmp(header.magic, internal::snapshotMagic,
+                            sizeof(header.magic)) != 0 ||
+                header.complete != 1 ||
+                header.checksum != internal::headerChecksum(header)) {
+                continue;
+            }
+            if (!compatible(header)) {
+                throw std::invalid_argument("Incompatible snapshot");
+            }
+            if (current < 0 || header.sequence > sequence) {
+                current = static_cast<int>(slot);
+                sequence = header.sequence;
+            }
+        }
+    }
+
+    internal::SnapshotHeader makeHeader(uint64_t number) const {
+        internal::SnapshotHeader header{};
+        std::memcpy(header.magic, internal::snapshotMagic, sizeof(header.magic));
+        header.version = internal::snapshotVersion;
+        header.complete = 1;
+        header.sequence = number;
+        header.pageSize = page;
+        header.memorySize = memorySize;
+        header.wordSize = sizeof(T);
+        header.stateSize = sizeof(Machine);
+        header.program = program;
+        header.checksum = internal::headerChecksum(header);
+        return header;
+    }
+
+    bool compatible(const internal::SnapshotHeader &header) const {
+        return header.version == internal::snapshotVersion &&
+               header.pageSize == page && header.memorySize == memorySize &&
+               header.wordSize == sizeof(T) &&
+               header.stateSize == sizeof(Machine) &&
+               header.program == program;
+    }
+
+    const uint64_t program;
+    const size_t page;
+    const size_t statePages;
+    internal::DirtyPages pages;
+    int fd = -1;
+    void *mapped = nullptr;
+    Machine *machine = nullptr;
+    // Miejsce najnowszego zrzutu w pliku, -1 gdy go nie ma.
+    int current = -1;
+    uint64_t sequence = 0;
+    bool restoredState = false;
+};
+
+#endif  // ASSEMBLER_SNAPSHOT_H
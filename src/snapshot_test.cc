@@ -0,0 +1,106 @@
+#include "snapshot.h"
+#include "computer_image.h"
+#include <cstdio>
+#include <iostream>
+#include <vector>
+
+using tmpasm_sum = Program<
+        D<Id("n"), Num<5000>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jnz<Id("loop")>>;
+
+// Ten sam rozmiar i dane, inny skok -- zrzut tmpasm_sum do niego nie pasuje.
+using tmpasm_other = Program<
+        D<Id("n"), Num<5000>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Mem<Lea<Id("n")>>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jz<Id("loop")>>;
+
+constexpr uint64_t sumKey = TypeKey<tmpasm_sum>::value;
+
+using Machine = Snapshot<4096, int>::Machine;
+using Runner = InstructionsRunner<Machine, tmpasm_sum::Instructions>;
+
+int main() {
+    const std::string path = "snapshot_test.img";
+    std::remove(path.c_str());
+    int failures = 0;
+
+    // Przerwanie w połowie, zapisy, dokończenie na odtworzonym stanie.
+    std::array<int, 4096> saved;
+    {
+        Snapshot<4096, int> snapshot(path, sumKey);
+        Machine &machine = snapshot.state();
+        if (snapshot.restored()) {
+            std::cout << "Failed [new snapshot]." << std::endl;
+            failures++;
+        }
+        InitialInstructionsParsing<Machine, tmpasm_sum::Instructions>::evaluate(
+                machine);
+        Runner::run(machine, 1000);
+        size_t full = snapshot.save();
+
+        // Drugie miejsce w pliku dostaje wszystko, kolejne zapisy -- tylko
+        // zmienione strony.
+        Runner::run(machine, 1000);
+        snapshot.save();
+        Runner::run(machine, 1000);
+        size_t incremental = snapshot.save();
+        if (incremental == 0 || incremental >= full) {
+            std::cout << "Failed [incremental save]." << std::endl;
+            failures++;
+        }
+        saved = machine.memoryBlocks;
+
+        // Przerwany czwarty zapis: śmieci w miejscu, do którego by trafił.
+        Runner::run(machine, 1000);
+        size_t page = internal::pageSize();
+        size_t slot = (sizeof(Machine) + page - 1) / page * page;
+        std::vector<char> garbage(slot, 'x');
+        int fd = ::open(path.c_str(), O_WRONLY);
+        internal::writeAll(fd, garbage.data(), slot,
+                           static_cast<off_t>(page + slot));
+        internal::writeAll(fd, garbage.data(), internal::snapshotHeaderSlot,
+                           internal::snapshotHeaderSlot);
+        ::close(fd);
+    }
+
+    {
+        Snapshot<4096, int> snapshot(path, sumKey);
+        if (!snapshot.restored() ||
+            snapshot.state().memoryBlocks != saved) {
+            std::cout << "Failed [restore after interrupted save]." << std::endl;
+            failures++;
+        }
+        Runner::evaluate(snapshot.state());
+        auto expected = Computer<4096, int>::boot<tmpasm_sum>();
+        if (snapshot.state().memoryBlocks != expected ||
+            snapshot.state().memoryBlocks[1] != 12502500) {
+            std::cout << "Failed [restore]." << std::endl;
+            failures++;
+        }
+    }
+
+    try {
+        Snapshot<2048, int> wrong(path, sumKey);
+        std::cout << "Failed [incompatible]." << std::endl;
+        failures++;
+    } catch (const std::invalid_argument &) {
+    }
+
+    // Zrzut innego programu jest odrzucany tak samo.
+    try {
+        Snapshot<4096, int> other(path, TypeKey<tmpasm_other>::value);
+        std::cout << "Failed [other program]." << std::endl;
+        failures++;
+    } catch (const std::invalid_argument &) {
+    }
+
+    std::remove(path.c_str());
+    return failures == 0 ? 0 : 1;
+}
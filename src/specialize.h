@@ -0,0 +1,1856 @@
+#ifndef ASSEMBLER_SPECIALIZE_H
+#define ASSEMBLER_SPECIALIZE_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+
+#include "computer.h"
+
+// Specjalizacja programu na znanych danych (częściowe obliczenie online).
+// Specialize<Computer<N, T>, P, Dynamic<Id...>>::type to program rezydualny,
+// który daje tę samą pamięć i to samo wyjście co P.
+//
+// P jest wykonywany abstrakcyjnie w czasie kompilacji. O każdej komórce
+// pamięci, rejestrze i fladze wiadomo, czy jej wartość jest statyczna
+// (znana), czy dynamiczna -- zależna od In albo od zmiennych wymienionych
+// w Dynamic. Instrukcja o statycznych argumentach jest wykonywana od razu
+// i znika z programu. Pozostałe trafiają do programu rezydualnego, a ich
+// statyczne argumenty są zamieniane na Num, a znane adresy na Mem<Num>.
+// Skok zależny od statycznych flag jest rozstrzygany, więc pętle o znanej
+// liczbie obrotów są rozwijane. Skok zależny od danych dynamicznych prowadzi
+// do wersji kodu za etykietą, wyspecjalizowanej dla bieżącej wiedzy o stanie.
+// Wersje powstają tylko w etykietach, do których prowadzi jakiś skok (przy
+// skokach pośrednich -- we wszystkich etykietach); przez pozostałe etykiety
+// wykonanie tylko przechodzi. Pętla z dynamicznym warunkiem jest uogólniana:
+// komórki, które zmieniają się między obrotami, stają się w niej dynamiczne.
+//
+// Wersji może być 64 plus dwie na każdą etykietę, do której prowadzi skok.
+// Każda wersja przechowuje kopię pamięci i wiedzę o każdej jej komórce -- dwie
+// tablice po memorySize elementów -- więc pamięć potrzebna kompilatorowi
+// rośnie jak iloczyn liczby takich etykiet i memorySize.
+//
+// Wartość statyczna trafia do maszyny dopiero, gdy jest potrzebna: przed
+// instrukcją rezydualną, która ją czyta, przed skokiem do wersji, w której
+// jest dynamiczna, i na końcu programu. Flag i rejestrów, które zostaną
+// nadpisane przed odczytem, nie zapisuje się wcale. Wskaźnik stosu jest
+// zawsze statyczny: Call i Ret są rozstrzygane w czasie kompilacji, a Push
+// i Pop danych dynamicznych stają się Mov pod znany adres. Błąd
+// w osiągalnym kodzie (np. odwołanie poza pamięć) staje się instrukcją,
+// która zgłasza ten sam wyjątek.
+//
+// Gdy programu nie da się tak zapisać -- Ret albo JmpInd pod dynamiczny
+// adres, różne głębokości stosu w jednej etykiecie, przekroczony limit kroków
+// albo rozmiar wyniku -- wynikiem jest P bez zmian.
+template <uint64_t... ids>
+struct Dynamic {};
+
+namespace internal {
+    // Zarezerwowane etykiety programu rezydualnego -- Id() i scopedId() ich
+    // nie tworzą.
+    constexpr uint64_t residualEnd = ~uint64_t(0);
+
+    constexpr uint64_t residualLabel(size_t variant) {
+        return ~uint64_t(0) - 1 - variant;
+    }
+
+    // Numer wersji oznaczający koniec programu.
+    constexpr size_t endVariant = ~size_t(0);
+
+    constexpr uint64_t variantLabel(size_t variant) {
+        return variant == endVariant ? residualEnd : residualLabel(variant);
+    }
+
+    // Błędy wykryte w czasie specjalizacji. Program rezydualny zgłasza je
+    // dopiero wtedy, gdy dojdzie do miejsca błędu.
+    enum class Failure : uint8_t {
+        Memory, Id, Overflow, Underflow, ReturnRange, ReturnTarget, JumpTarget,
+        TableIndex
+    };
+
+    template <Failure failure>
+    struct Fail {};
+
+    // Wiedza o komórce, rejestrze albo fladze: wartość nieznana, znana albo
+    // znana i już zapisana w maszynie.
+    enum class Known : uint8_t { Dynamic, Static, Synced };
+
+    // Flagi jako bity masek, w kolejności zf, sf, cf, of, lf.
+    constexpr size_t flagCount = 5;
+    constexpr uint8_t zfFlag = 1;
+    constexpr uint8_t sfFlag = 2;
+    constexpr uint8_t cfFlag = 4;
+    constexpr uint8_t ofFlag = 8;
+    constexpr uint8_t lfFlag = 16;
+    constexpr uint8_t allFlags = 31;
+
+    template <typename S>
+    constexpr auto &flag(S &s, size_t f) {
+        switch (f) {
+            case 0: return s.zf;
+            case 1: return s.sf;
+            case 2: return s.cf;
+            case 3: return s.of;
+        }
+        return s.lf;
+    }
+
+    constexpr uint8_t conditionFlags(Cc cc) {
+        switch (cc) {
+            case Cc::O: case Cc::NO: return ofFlag;
+            case Cc::B: case Cc::AE: return cfFlag;
+            case Cc::E: case Cc::NE: return zfFlag;
+            case Cc::BE: case Cc::A: return cfFlag | zfFlag;
+            case Cc::S: case Cc::NS: return sfFlag;
+            case Cc::L: case Cc::GE: return lfFlag;
+            case Cc::LE: case Cc::G: return zfFlag | lfFlag;
+        }
+        return allFlags;
+    }
+
+    // Flagi ustawiane przez Cmp -- do odtworzenia flag w maszynie.
+    template <typename T>
+    struct FlagState {
+        using Word = T;
+        bool zf = false;
+        bool sf = false;
+        bool cf = false;
+        bool of = false;
+        bool lf = false;
+    };
+
+    template <std::size_t memorySize, typename T>
+    struct TraceState : public State<memorySize, T> {
+        // In i Out nigdy nie są wykonywane w czasie specjalizacji.
+        constexpr bool input(size_t, T &) {
+            throw std::invalid_argument("Unbound port");
+        }
+
+        constexpr void output(size_t, T) {
+            throw std::invalid_argument("Unbound port");
+        }
+    };
+
+    // Zamiana argumentu w instrukcji rezydualnej, dla każdego węzła drzewa
+    // argumentów w kolejności prefiksowej.
+    // Index to stała typu size_t -- adres zmiennej z Lea, który nie może
+    // zmienić typu na typ słowa.
+    enum class Rewrite : uint8_t { Keep, Value, Address, Index };
+
+    constexpr size_t residualNodes = 16;
+    constexpr size_t residualTargets = 16;
+
+    enum class Emit : uint8_t {
+        Original, SetCell, SetRegister, Compare, Label, Jump, Fail
+    };
+
+    // Instrukcja programu rezydualnego. Original to instrukcja P spod adresu
+    // source z zamienionymi argumentami, pozostałe są tworzone od zera.
+    template <typename T>
+    struct ResidualItem {
+        Emit kind = Emit::Original;
+        size_t source = 0;
+        // Komórka, rejestr, wersja albo rodzaj błędu.
+        size_t index = 0;
+        bool known = false;
+        T value{};
+        T other{};
+        std::array<Rewrite, residualNodes> rewrite{};
+        std::array<T, residualNodes> values{};
+        std::array<size_t, residualNodes> addresses{};
+        // Wersje, do których instrukcja skacze, i czy zawsze skacze.
+        std::array<size_t, residualTargets> targets{};
+        size_t targetCount = 0;
+        bool ends = false;
+    };
+
+    // Argument obliczony abstrakcyjnie.
+    enum class Where : uint8_t { Nowhere, Cell, Register, Anywhere };
+
+    template <typename T>
+    struct Arg {
+        bool failed = false;
+        Failure failure = Failure::Memory;
+        bool known = false;
+        T value{};
+        Where where = Where::Nowhere;
+        size_t index = 0;
+        // Dla Num i Lea: wartość w typie argumentu, a nie słowa, jako składnik
+        // adresu Mem (fits == false, gdy nie mieści się w long long).
+        bool exact = false;
+        bool fits = false;
+        long long part = 0;
+    };
+
+    template <typename T>
+    constexpr bool addressPart(const Arg<T> &arg, long long &part) {
+        if (arg.exact) {
+            part = arg.part;
+            return arg.fits;
+        }
+        return addressPart(arg.value, part);
+    }
+
+    template <typename X>
+    struct Abstract;
+
+    template <auto V>
+    struct Abstract<Num<V>> {
+        static constexpr size_t nodes = 1;
+
+        template <typename E, typename Item>
+        static constexpr auto eval(E &, Item &, size_t, bool) {
+            Arg<typename E::Word> arg{};
+            arg.known = true;
+            arg.value = static_cast<typename E::Word>(V);
+            arg.exact = true;
+            arg.fits = addressPart(V, arg.part);
+            return arg;
+        }
+    };
+
+    template <uint64_t I>
+    struct Abstract<Lea<I>> {
+        static constexpr size_t nodes = 1;
+
+        template <typename E, typename Item>
+        static constexpr auto eval(E &e, Item &item, size_t node, bool) {
+            Arg<typename E::Word> arg{};
+            arg.failed = true;
+            arg.failure = Failure::Id;
+            for (size_t i = 0; i < e.machine.decCount; i++) {
+                if (e.machine.declarationIDs[i] == I) {
+                    arg.failed = false;
+                    arg.known = true;
+                    arg.value = static_cast<typename E::Word>(i);
+                    arg.exact = true;
+                    arg.fits = addressPart(i, arg.part);
+                    item.rewrite[node] = Rewrite::Index;
+                    item.addresses[node] = i;
+                    break;
+                }
+            }
+            return arg;
+        }
+    };
+
+    template <std::size_t I>
+    struct Abstract<Reg<I>> {
+        static constexpr size_t nodes = 1;
+
+        template <typename E, typename Item>
+        static constexpr auto eval(E &e, Item &item, size_t node, bool lvalue) {
+            Arg<typename E::Word> arg{};
+            arg.where = Where::Register;
+            arg.index = I;
+            arg.known = e.regs[I] != Known::Dynamic;
+            arg.value = e.machine.registers[I];
+            if (!lvalue && arg.known) {
+                item.rewrite[node] = Rewrite::Value;
+                item.values[node] = arg.value;
+            }
+            return arg;
+        }
+    };
+
+    template <typename Base, typename Index, std::ptrdiff_t scale,
+            std::ptrdiff_t offset>
+    struct Abstract<Mem<Base, Index, scale, offset>> {
+        static constexpr size_t nodes =
+                1 + Abstract<Base>::nodes + Abstract<Index>::nodes;
+
+        template <typename E, typename Item>
+        static constexpr auto eval(E &e, Item &item, size_t node, bool lvalue) {
+            auto base = Abstract<Base>::eval(e, item, node + 1, false);
+            auto index = Abstract<Index>::eval(
+                    e, item, node + 1 + Abstract<Base>::nodes, false);
+            if (base.failed) {
+                return base;
+            }
+            if (index.failed) {
+                return index;
+            }
+            Arg<typename E::Word> arg{};
+            if (!base.known || !index.known) {
+                arg.where = Where::Anywhere;
+                return arg;
+            }
+            long long b = 0;
+            long long i = 0;
+            size_t address = addressPart(base, b) && addressPart(index, i)
+                                     ? linearAddress(b, i, scale, offset)
+                                     : ~size_t(0);
+            if (address >= E::Machine::size) {
+                arg.failed = true;
+                arg.failure = Failure::Memory;
+                return arg;
+            }
+            arg.where = Where::Cell;
+            arg.index = address;
+            arg.known = e.cells[address] != Known::Dynamic;
+            arg.value = e.machine.memoryBlocks[address];
+            if (!lvalue && arg.known) {
+                item.rewrite[node] = Rewrite::Value;
+                item.values[node] = arg.value;
+            } else {
+                item.rewrite[node] = Rewrite::Address;
+                item.addresses[node] = address;
+            }
+            return arg;
+        }
+    };
+
+    template <typename... Args>
+    constexpr std::array<size_t, sizeof...(Args) + 1> nodeOffsets() {
+        constexpr size_t counts[] = {Abstract<Args>::nodes..., 0};
+        std::array<size_t, sizeof...(Args) + 1> offsets{};
+        for (size_t i = 0; i < sizeof...(Args); i++) {
+            offsets[i + 1] = offsets[i] + counts[i];
+        }
+        return offsets;
+    }
+
+    // Użycie argumentu przez instrukcję.
+    enum class Role : uint8_t { Read, Write, ReadWrite };
+
+    // Flagi i rejestry jako bity masek żywotności: najpierw flagi, potem
+    // Reg<0>...Reg<registerCount - 1>.
+    template <typename X>
+    struct OperandRegisters {
+        // Rejestry czytane przy wyznaczaniu adresu i rejestr, który jest
+        // samym argumentem.
+        static constexpr uint32_t address = 0;
+        static constexpr uint32_t self = 0;
+    };
+
+    template <std::size_t I>
+    struct OperandRegisters<Reg<I>> {
+        static constexpr uint32_t address = 0;
+        static constexpr uint32_t self = uint32_t(1) << (flagCount + I);
+    };
+
+    template <typename Base, typename Index, std::ptrdiff_t scale,
+            std::ptrdiff_t offset>
+    struct OperandRegisters<Mem<Base, Index, scale, offset>> {
+        static constexpr uint32_t address =
+                OperandRegisters<Base>::address | OperandRegisters<Base>::self |
+                OperandRegisters<Index>::address | OperandRegisters<Index>::self;
+        static constexpr uint32_t self = 0;
+    };
+
+    template <Role r, typename X>
+    struct Use {
+        static constexpr Role role = r;
+        using Operand = X;
+        static constexpr uint32_t use =
+                OperandRegisters<X>::address |
+                (r != Role::Write ? OperandRegisters<X>::self : 0);
+        static constexpr uint32_t def =
+                r == Role::Write ? OperandRegisters<X>::self : 0;
+    };
+
+    // Skutki instrukcji: czytane i zapisywane flagi, argumenty, a dla
+    // żywotności -- czytane (use) i na pewno nadpisywane (def) flagi
+    // i rejestry. forced -- instrukcja zawsze zostaje w programie.
+    template <uint8_t r, uint8_t w, bool f, typename... Uses>
+    struct DataEffects {
+        static constexpr uint8_t read = r;
+        static constexpr uint8_t write = w;
+        static constexpr bool forced = f;
+        using Operands = std::tuple<Uses...>;
+        static constexpr uint32_t use = (uint32_t(r) | ... | Uses::use);
+        static constexpr uint32_t def = (uint32_t(w) | ... | Uses::def);
+    };
+
+    template <typename Ins>
+    struct Effects {
+        static constexpr uint32_t use = 0;
+        static constexpr uint32_t def = 0;
+    };
+
+    template <typename Dst, typename Src>
+    struct Effects<Mov<Dst, Src>> : DataEffects<0, 0, false,
+            Use<Role::Write, Dst>, Use<Role::Read, Src>> {};
+
+    template <Cc cc, typename Dst, typename Src>
+    struct Effects<CMov<cc, Dst, Src>> : DataEffects<conditionFlags(cc), 0,
+            false, Use<Role::ReadWrite, Dst>, Use<Role::Read, Src>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Add<Arg1, Arg2>> : DataEffects<0, allFlags, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Sub<Arg1, Arg2>> : DataEffects<0, allFlags, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Adc<Arg1, Arg2>> : DataEffects<cfFlag, allFlags, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Sbb<Arg1, Arg2>> : DataEffects<cfFlag, allFlags, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg>
+    struct Effects<Inc<Arg>> : DataEffects<0, allFlags & ~cfFlag, false,
+            Use<Role::ReadWrite, Arg>> {};
+
+    template <typename Arg>
+    struct Effects<Dec<Arg>> : DataEffects<0, allFlags & ~cfFlag, false,
+            Use<Role::ReadWrite, Arg>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<And<Arg1, Arg2>> : DataEffects<0, zfFlag, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Or<Arg1, Arg2>> : DataEffects<0, zfFlag, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg>
+    struct Effects<Not<Arg>> : DataEffects<0, zfFlag, false,
+            Use<Role::ReadWrite, Arg>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Cmp<Arg1, Arg2>> : DataEffects<0, allFlags, false,
+            Use<Role::Read, Arg1>, Use<Role::Read, Arg2>> {};
+
+    template <typename Arg1, typename Arg2>
+    struct Effects<Xchg<Arg1, Arg2>> : DataEffects<0, 0, false,
+            Use<Role::ReadWrite, Arg1>, Use<Role::ReadWrite, Arg2>> {};
+
+    template <typename Dst, typename Expected, typename Desired>
+    struct Effects<CmpXchg<Dst, Expected, Desired>> : DataEffects<0, zfFlag,
+            false, Use<Role::ReadWrite, Dst>, Use<Role::ReadWrite, Expected>,
+            Use<Role::Read, Desired>> {};
+
+    template <typename Dst, typename Src>
+    struct Effects<FetchAdd<Dst, Src>> : DataEffects<0, allFlags, false,
+            Use<Role::ReadWrite, Dst>, Use<Role::ReadWrite, Src>> {};
+
+    // In na końcu strumienia nie zmienia Dst, więc Dst jest też czytane.
+    template <typename Dst, size_t port>
+    struct Effects<In<Dst, port>> : DataEffects<0, zfFlag, true,
+            Use<Role::ReadWrite, Dst>> {};
+
+    template <size_t port, typename Src>
+    struct Effects<Out<port, Src>> : DataEffects<0, 0, true,
+            Use<Role::Read, Src>> {};
+
+    template <Cc cc, uint64_t label>
+    struct Effects<Jcc<cc, label>> {
+        static constexpr uint32_t use = conditionFlags(cc);
+        static constexpr uint32_t def = 0;
+    };
+
+    template <typename Index, uint64_t... labels>
+    struct Effects<JmpTable<Index, labels...>> {
+        static constexpr uint32_t use = Use<Role::Read, Index>::use;
+        static constexpr uint32_t def = 0;
+    };
+
+    template <typename Src>
+    struct Effects<JmpInd<Src>> {
+        static constexpr uint32_t use = Use<Role::Read, Src>::use;
+        static constexpr uint32_t def = 0;
+    };
+
+    template <typename Src>
+    struct Effects<Push<Src>> {
+        static constexpr uint32_t use = Use<Role::Read, Src>::use;
+        static constexpr uint32_t def = 0;
+    };
+
+    template <typename Dst>
+    struct Effects<Pop<Dst>> {
+        static constexpr uint32_t use = Use<Role::Write, Dst>::use;
+        static constexpr uint32_t def = Use<Role::Write, Dst>::def;
+    };
+
+    template <typename Origin, typename Instructions = Origin>
+    struct InstructionEffects;
+
+    template <typename Origin, typename... Instructions>
+    struct InstructionEffects<Origin, std::tuple<Instructions...>> {
+        static constexpr std::array<uint32_t, sizeof...(Instructions) + 1>
+        use() {
+            return {Effects<typename ResolveLabels<Origin,
+                    Instructions>::type>::use..., 0};
+        }
+
+        static constexpr std::array<uint32_t, sizeof...(Instructions) + 1>
+        def() {
+            return {Effects<typename ResolveLabels<Origin,
+                    Instructions>::type>::def..., 0};
+        }
+    };
+
+    // Flagi i rejestry żywe przed każdą instrukcją: ich wartość może zostać
+    // odczytana, zanim zostanie nadpisana. Następniki instrukcji pochodzą
+    // z grafu przepływu BasicBlocks. Na końcu programu nic nie jest żywe,
+    // bo wynikiem jest tylko pamięć.
+    template <typename Origin>
+    struct Liveness {
+        static constexpr size_t size = std::tuple_size<Origin>::value;
+
+        static constexpr std::array<uint32_t, size + 1> build() {
+            constexpr size_t n = size;
+            constexpr auto &blocks = BasicBlocks<Origin>::layout;
+            constexpr auto use = InstructionEffects<Origin>::use();
+            constexpr auto def = InstructionEffects<Origin>::def();
+
+            // Następniki Ret (adresy za Call) i skoków pośrednich (etykiety),
+            // zebrane raz dla całego programu.
+            std::array<size_t, n + 1> returns{}, labels{};
+            size_t returnCount = 0, labelCount = 0;
+            for (size_t j = 0; j < n; j++) {
+                if (blocks.call[j]) {
+                    returns[returnCount++] = j + 1;
+                }
+                if (blocks.label[j]) {
+                    labels[labelCount++] = j;
+                }
+            }
+
+            std::array<uint32_t, n + 1> live{};
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (size_t i = n; i-- > 0;) {
+                    uint32_t out = 0;
+                    switch (blocks.flow[i]) {
+                        case Flow::Next:
+                            out = live[i + 1];
+                            break;
+                        case Flow::Branch:
+                            out = live[i + 1] | live[blocks.target[i]];
+                            break;
+                        case Flow::Jump:
+                        case Flow::Call:
+                            out = live[blocks.target[i]];
+                            break;
+                        case Flow::Return:
+                            for (size_t k = 0; k < returnCount; k++) {
+                                out |= live[returns[k]];
+                            }
+                            break;
+                        case Flow::Indirect:
+                            for (size_t k = 0; k < labelCount; k++) {
+                                out |= live[labels[k]];
+                            }
+                            break;
+                    }
+                    uint32_t in = use[i] | (out & ~def[i]);
+                    if (in != live[i]) {
+                        live[i] = in;
+                        changed = true;
+                    }
+                }
+            }
+            return live;
+        }
+
+        static constexpr std::array<uint32_t, size + 1> live = build();
+    };
+
+    template <typename S, typename Origin, typename Dyn, size_t limit>
+    struct PartialEvaluator;
+
+    template <std::size_t memorySize, typename T, typename... Instructions,
+            uint64_t... ids, size_t limit>
+    struct PartialEvaluator<TraceState<memorySize, T>,
+            std::tuple<Instructions...>, Dynamic<ids...>, limit> {
+        using Machine = TraceState<memorySize, T>;
+        using Word = T;
+        using Origin = std::tuple<Instructions...>;
+        using Item = ResidualItem<T>;
+        using U = Unsigned<T>;
+        using Step = void (*)(PartialEvaluator &);
+
+        static constexpr size_t size = sizeof...(Instructions);
+        static constexpr size_t none = ~size_t(0);
+        // Etykiety, w których powstają wersje: cele skoków, a przy skokach
+        // pośrednich wszystkie etykiety.
+        static constexpr std::array<bool, size + 1> joinPoints() {
+            constexpr size_t n = size;
+            constexpr auto &blocks = BasicBlocks<Origin>::layout;
+            std::array<bool, n + 1> join{};
+            bool indirect = false;
+            for (size_t i = 0; i < n; i++) {
+                switch (blocks.flow[i]) {
+                    case Flow::Jump:
+                    case Flow::Branch:
+                    case Flow::Call:
+                        if (blocks.target[i] < n) {
+                            join[blocks.target[i]] = true;
+                        }
+                        break;
+                    case Flow::Indirect:
+                        indirect = true;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            for (size_t i = 0; indirect && i < n; i++) {
+                join[i] = join[i] || blocks.label[i];
+            }
+            return join;
+        }
+
+        static constexpr size_t countJoinPoints() {
+            constexpr auto join = joinPoints();
+            size_t count = 0;
+            for (bool j : join) {
+                count += j;
+            }
+            return count;
+        }
+
+        static constexpr size_t maxVariants = 64 + 2 * countJoinPoints();
+        static constexpr size_t maxCode = 8 * size + 256;
+        // Obroty pętli z kodem rezydualnym rozwijane przed uogólnieniem.
+        static constexpr size_t unroll = 16;
+
+        // Wiedza o stanie na początku wersji kodu za etykietą pc.
+        struct Variant {
+            size_t pc = 0;
+            size_t sp = 0;
+            std::array<T, memorySize> memory{};
+            std::array<Known, memorySize> cells{};
+            std::array<T, registerCount> registers{};
+            std::array<Known, registerCount> regs{};
+            std::array<bool, flagCount> flagValues{};
+            std::array<Known, flagCount> flags{};
+            bool generated = false;
+        };
+
+        struct Result {
+            bool ok = true;
+            size_t count = 0;
+            std::array<Item, maxCode> items{};
+        };
+
+        Machine machine{};
+        std::array<Known, memorySize> cells{};
+        std::array<Known, registerCount> regs{};
+        std::array<Known, flagCount> flags{};
+        std::array<Variant, maxVariants> variants{};
+        size_t variantCount = 0;
+        // Pierwsza wersja utworzona w bieżącym przebiegu.
+        size_t traceStart = 0;
+        Result result{};
+        bool stop = false;
+        size_t counter = 0;
+        // Dla etykiet bieżącego przebiegu: długość kodu przy ostatniej
+        // wizycie, wersja otwierająca pętlę, długość kodu za jej etykietą
+        // i liczba rozwiniętych obrotów.
+        std::array<size_t, size + 1> lastVisit{};
+        std::array<size_t, size + 1> head{};
+        std::array<size_t, size + 1> headAt{};
+        std::array<size_t, size + 1> unrolled{};
+        std::array<bool, size + 1> join{};
+
+        static constexpr Machine parse() {
+            Machine s{};
+            InitialInstructionsParsing<Machine, Origin>::evaluate(s);
+            return s;
+        }
+
+        static constexpr Result run() {
+            constexpr Step steps[] = {
+                    &PartialEvaluator::template visit<typename ResolveLabels<
+                            Origin, Instructions>::type>...,
+                    nullptr};
+
+            PartialEvaluator e{};
+            e.machine = parse();
+            e.join = joinPoints();
+            for (size_t i = 0; i < memorySize; i++) {
+                e.cells[i] = Known::Synced;
+            }
+            for (size_t i = 0; i < registerCount; i++) {
+                e.regs[i] = Known::Synced;
+            }
+            for (size_t f = 0; f < flagCount; f++) {
+                e.flags[f] = Known::Synced;
+            }
+            ((e.cells[e.machine.lookup(ids)] = Known::Dynamic), ...);
+            e.begin();
+            e.trace(steps);
+            for (size_t v = 0; e.result.ok && v < e.variantCount; v++) {
+                if (!e.variants[v].generated) {
+                    e.variants[v].generated = true;
+                    e.begin();
+                    e.load(v);
+                    e.enter(v);
+                    e.trace(steps);
+                }
+            }
+            if (e.result.ok) {
+                e.cleanup();
+            }
+            return e.result;
+        }
+
+        template <typename Ins>
+        static constexpr void visit(PartialEvaluator &e) {
+            e.execute(static_cast<Ins *>(nullptr));
+        }
+
+        constexpr void trace(const Step *steps) {
+            stop = false;
+            while (!stop) {
+                if (++counter > limit) {
+                    bail();
+                    return;
+                }
+                if (machine.pc >= size) {
+                    syncMemory();
+                    jump(endVariant);
+                    return;
+                }
+                steps[machine.pc](*this);
+            }
+        }
+
+        /* Kod rezydualny */
+
+        constexpr void emit(const Item &item) {
+            if (!result.ok) {
+                return;
+            }
+            if (result.count == maxCode) {
+                bail();
+                return;
+            }
+            result.items[result.count++] = item;
+        }
+
+        // Programu nie da się wyspecjalizować.
+        constexpr void bail() {
+            result.ok = false;
+            stop = true;
+        }
+
+        constexpr void fail(Failure failure) {
+            Item item{};
+            item.kind = Emit::Fail;
+            item.index = static_cast<size_t>(failure);
+            item.ends = true;
+            emit(item);
+            stop = true;
+        }
+
+        constexpr void jump(size_t variant) {
+            Item item{};
+            item.kind = Emit::Jump;
+            item.targets[0] = variant;
+            item.targetCount = 1;
+            item.ends = true;
+            emit(item);
+            stop = true;
+        }
+
+        constexpr void label(size_t variant) {
+            Item item{};
+            item.kind = Emit::Label;
+            item.index = variant;
+            emit(item);
+        }
+
+        constexpr void syncCell(size_t address) {
+            if (cells[address] == Known::Static) {
+                Item item{};
+                item.kind = Emit::SetCell;
+                item.index = address;
+                item.value = machine.memoryBlocks[address];
+                emit(item);
+                cells[address] = Known::Synced;
+            }
+        }
+
+        constexpr void syncRegister(size_t reg) {
+            if (regs[reg] == Known::Static) {
+                Item item{};
+                item.kind = Emit::SetRegister;
+                item.index = reg;
+                item.value = machine.registers[reg];
+                emit(item);
+                regs[reg] = Known::Synced;
+            }
+        }
+
+        constexpr void syncMemory() {
+            for (size_t i = 0; i < memorySize; i++) {
+                syncCell(i);
+            }
+        }
+
+        // Flagi z maski muszą mieć w maszynie swoje wartości. Odtwarza je
+        // jedno Cmp, które zmienia wszystkie flagi, więc żadna nie może być
+        // wtedy dynamiczna.
+        constexpr void syncFlags(uint8_t mask) {
+            bool needed = false;
+            for (size_t f = 0; f < flagCount; f++) {
+                needed |= (mask >> f & 1) && flags[f] == Known::Static;
+            }
+            if (!needed) {
+                return;
+            }
+            for (size_t f = 0; f < flagCount; f++) {
+                if (flags[f] == Known::Dynamic) {
+                    bail();
+                    return;
+                }
+            }
+            constexpr T candidates[] = {
+                    T(0), T(1), static_cast<T>(~U(0)),
+                    static_cast<T>(~(static_cast<U>(~U(0)) >> 1)),
+                    static_cast<T>(static_cast<U>(~U(0)) >> 1)};
+            for (T a : candidates) {
+                for (T b : candidates) {
+                    FlagState<T> s{};
+                    sub(s, a, b);
+                    s.sf = a < b;
+                    bool match = true;
+                    for (size_t f = 0; f < flagCount; f++) {
+                        match &= !(mask >> f & 1) ||
+                                 flag(s, f) == flag(machine, f);
+                    }
+                    if (match) {
+                        Item item{};
+                        item.kind = Emit::Compare;
+                        item.value = a;
+                        item.other = b;
+                        emit(item);
+                        for (size_t f = 0; f < flagCount; f++) {
+                            flags[f] = flag(s, f) == flag(machine, f)
+                                               ? Known::Synced
+                                               : Known::Static;
+                        }
+                        return;
+                    }
+                }
+            }
+            bail();
+        }
+
+        constexpr T &place(const Arg<T> &arg) {
+            return arg.where == Where::Cell ? machine.memoryBlocks[arg.index]
+                                            : machine.registers[arg.index];
+        }
+
+        constexpr Known &status(const Arg<T> &arg) {
+            return arg.where == Where::Cell ? cells[arg.index] : regs[arg.index];
+        }
+
+        static constexpr bool located(const Arg<T> &arg) {
+            return arg.where == Where::Cell || arg.where == Where::Register;
+        }
+
+        // Zapis wartości statycznej.
+        static constexpr void written(Known &known, T old, T now) {
+            known = known == Known::Synced && old == now ? Known::Synced
+                                                         : Known::Static;
+        }
+
+        constexpr void store(size_t address, T value) {
+            T old = machine.memoryBlocks[address];
+            machine.memoryBlocks[address] = value;
+            written(cells[address], old, value);
+        }
+
+        constexpr void sync(const Arg<T> &arg) {
+            if (arg.where == Where::Cell) {
+                syncCell(arg.index);
+            } else if (arg.where == Where::Register) {
+                syncRegister(arg.index);
+            }
+        }
+
+        constexpr void forget(const Arg<T> &arg) {
+            if (located(arg)) {
+                status(arg) = Known::Dynamic;
+            } else if (arg.where == Where::Anywhere) {
+                for (size_t i = 0; i < memorySize; i++) {
+                    cells[i] = Known::Dynamic;
+                }
+            }
+        }
+
+        constexpr bool flagsKnown(uint8_t mask) const {
+            for (size_t f = 0; f < flagCount; f++) {
+                if ((mask >> f & 1) && flags[f] == Known::Dynamic) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /* Wersje kodu */
+
+        constexpr Variant save(size_t pc) const {
+            Variant v{};
+            v.pc = pc;
+            v.sp = machine.sp;
+            v.memory = machine.memoryBlocks;
+            v.cells = cells;
+            v.registers = machine.registers;
+            v.regs = regs;
+            for (size_t f = 0; f < flagCount; f++) {
+                v.flagValues[f] = flag(machine, f);
+            }
+            v.flags = flags;
+            // Martwe flagi i rejestry nie są czytane przez kod wersji, więc
+            // nie trzeba ich zapisywać w maszynie ani rozróżniać wersji ich
+            // wartościami.
+            uint32_t alive = Liveness<Origin>::live[pc];
+            for (size_t f = 0; f < flagCount; f++) {
+                if (!(alive >> f & 1)) {
+                    v.flagValues[f] = false;
+                    v.flags[f] = Known::Static;
+                }
+            }
+            for (size_t i = 0; i < registerCount; i++) {
+                if (!(alive >> (flagCount + i) & 1)) {
+                    v.registers[i] = 0;
+                    v.regs[i] = Known::Static;
+                }
+            }
+            return v;
+        }
+
+        constexpr void load(size_t variant) {
+            const Variant &v = variants[variant];
+            machine.pc = v.pc;
+            machine.sp = v.sp;
+            machine.memoryBlocks = v.memory;
+            cells = v.cells;
+            machine.registers = v.registers;
+            regs = v.regs;
+            for (size_t f = 0; f < flagCount; f++) {
+                flag(machine, f) = v.flagValues[f];
+            }
+            flags = v.flags;
+        }
+
+        template <typename V, size_t n>
+        static constexpr bool agree(const std::array<V, n> &a,
+                                    const std::array<Known, n> &ka,
+                                    const std::array<V, n> &b,
+                                    const std::array<Known, n> &kb, bool same) {
+            for (size_t i = 0; i < n; i++) {
+                bool da = ka[i] == Known::Dynamic;
+                bool db = kb[i] == Known::Dynamic;
+                if (db && !same) {
+                    continue;
+                }
+                if (da != db || (!da && a[i] != b[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        // Czy kod wersji b pasuje do stanu a: ta sama wiedza albo, gdy !same,
+        // b wie mniej, ale nie inaczej.
+        static constexpr bool fits(const Variant &a, const Variant &b,
+                                   bool same) {
+            return a.pc == b.pc && a.sp == b.sp &&
+                   agree(a.memory, a.cells, b.memory, b.cells, same) &&
+                   agree(a.registers, a.regs, b.registers, b.regs, same) &&
+                   agree(a.flagValues, a.flags, b.flagValues, b.flags, same);
+        }
+
+        // Wersja dla stanu v: o tej samej wiedzy, a bez niej ogólniejsza.
+        constexpr size_t find(const Variant &v) const {
+            size_t covering = none;
+            for (size_t w = 0; w < variantCount; w++) {
+                if (fits(v, variants[w], true)) {
+                    return w;
+                }
+                if (covering == none && fits(v, variants[w], false)) {
+                    covering = w;
+                }
+            }
+            return covering;
+        }
+
+        template <typename V, size_t n>
+        static constexpr void meet(const std::array<V, n> &a,
+                                   std::array<Known, n> &ka,
+                                   const std::array<V, n> &b,
+                                   const std::array<Known, n> &kb) {
+            for (size_t i = 0; i < n; i++) {
+                if (ka[i] == Known::Dynamic || kb[i] == Known::Dynamic ||
+                    a[i] != b[i]) {
+                    ka[i] = Known::Dynamic;
+                } else if (kb[i] == Known::Static) {
+                    ka[i] = Known::Static;
+                }
+            }
+        }
+
+        // Wiedza wspólna dla stanów a i b.
+        constexpr Variant meet(Variant a, const Variant &b) {
+            if (a.sp != b.sp) {
+                bail();
+            }
+            meet(a.memory, a.cells, b.memory, b.cells);
+            meet(a.registers, a.regs, b.registers, b.regs);
+            meet(a.flagValues, a.flags, b.flagValues, b.flags);
+            a.generated = false;
+            return a;
+        }
+
+        constexpr size_t add(const Variant &v) {
+            if (variantCount == maxVariants) {
+                bail();
+                return none;
+            }
+            variants[variantCount] = v;
+            return variantCount++;
+        }
+
+        // Wersja dla skoku warunkowego. Skok wstecz do pętli bieżącego
+        // przebiegu, do której żadna wersja nie pasuje, uogólnia tę pętlę
+        // (none) zamiast zaczynać jej kolejną kopię.
+        constexpr size_t branch(size_t target) {
+            Variant v = save(target);
+            if (head[target] != none && find(v) == none) {
+                restart(target, v);
+                return none;
+            }
+            return variantFor(target);
+        }
+
+        // Wersja dla skoku pod adres target z bieżącego stanu.
+        constexpr size_t variantFor(size_t target) {
+            Variant v = save(target);
+            size_t found = find(v);
+            if (found != none) {
+                return found;
+            }
+            size_t count = 0;
+            size_t last = none;
+            for (size_t w = 0; w < variantCount; w++) {
+                if (variants[w].pc == target) {
+                    count++;
+                    last = w;
+                }
+            }
+            if (count >= unroll) {
+                v = meet(v, variants[last]);
+                found = find(v);
+                if (found != none) {
+                    return found;
+                }
+            }
+            return add(v);
+        }
+
+        constexpr uint8_t flagNeed(size_t variant) const {
+            uint8_t mask = 0;
+            for (size_t f = 0; f < flagCount; f++) {
+                if (variants[variant].flags[f] != Known::Static) {
+                    mask |= uint8_t(1) << f;
+                }
+            }
+            return mask;
+        }
+
+        // Zapisanie w maszynie wartości, które wersja uważa za zapisane albo
+        // dynamiczne.
+        constexpr void syncFor(size_t variant) {
+            const Variant &v = variants[variant];
+            for (size_t i = 0; i < memorySize; i++) {
+                if (v.cells[i] != Known::Static) {
+                    syncCell(i);
+                }
+            }
+            for (size_t i = 0; i < registerCount; i++) {
+                if (v.regs[i] != Known::Static) {
+                    syncRegister(i);
+                }
+            }
+        }
+
+        constexpr void transition(size_t variant) {
+            syncFlags(flagNeed(variant));
+            syncFor(variant);
+        }
+
+        constexpr void begin() {
+            traceStart = variantCount;
+            for (size_t i = 0; i <= size; i++) {
+                lastVisit[i] = none;
+                head[i] = none;
+                headAt[i] = none;
+                unrolled[i] = 0;
+            }
+        }
+
+        // Etykieta wersji na początku jej kodu.
+        constexpr void enter(size_t variant) {
+            label(variant);
+            size_t pc = machine.pc;
+            head[pc] = variant;
+            headAt[pc] = result.count;
+            lastVisit[pc] = result.count;
+            unrolled[pc] = 0;
+            machine.pc++;
+        }
+
+        constexpr void visitLabel() {
+            size_t pc = machine.pc;
+            // Tu wchodzi się tylko z poprzedniej instrukcji.
+            if (!join[pc]) {
+                machine.pc++;
+                return;
+            }
+            // Obrót pętli bez kodu rezydualnego -- rozwijany dalej.
+            if (lastVisit[pc] == result.count) {
+                machine.pc++;
+                return;
+            }
+            size_t found = find(save(pc));
+            if (found != none) {
+                transition(found);
+                jump(found);
+                return;
+            }
+            if (head[pc] == none) {
+                size_t v = add(save(pc));
+                if (v != none) {
+                    variants[v].generated = true;
+                    load(v);
+                    enter(v);
+                }
+                return;
+            }
+            if (unrolled[pc] < unroll) {
+                unrolled[pc]++;
+                lastVisit[pc] = result.count;
+                machine.pc++;
+                return;
+            }
+            restart(pc, save(pc));
+        }
+
+        // Pętla z kodem rezydualnym zmienia stan w każdym obrocie: kod od
+        // jej pierwszej etykiety jest porzucany, a pętla zaczyna się od nowa
+        // z wiedzą wspólną dla obu obrotów.
+        constexpr void restart(size_t pc, const Variant &current) {
+            size_t h = head[pc];
+            Variant general = meet(current, variants[h]);
+            if (!result.ok) {
+                return;
+            }
+            size_t at = headAt[pc];
+            result.count = at;
+            variantCount = h + 1 > traceStart ? h + 1 : traceStart;
+            for (size_t i = 0; i <= size; i++) {
+                if (lastVisit[i] != none && lastVisit[i] > at) {
+                    lastVisit[i] = none;
+                }
+                if (head[i] != none && headAt[i] > at) {
+                    head[i] = none;
+                    headAt[i] = none;
+                    unrolled[i] = 0;
+                }
+            }
+            load(h);
+            size_t found = find(general);
+            if (found != none) {
+                transition(found);
+                jump(found);
+                return;
+            }
+            size_t v = add(general);
+            if (v == none) {
+                return;
+            }
+            variants[v].generated = true;
+            transition(v);
+            load(v);
+            enter(v);
+        }
+
+        /* Instrukcje */
+
+        template <typename Ins>
+        constexpr void data() {
+            data<Ins>(static_cast<typename Effects<Ins>::Operands *>(nullptr));
+        }
+
+        template <typename Ins, typename... Uses>
+        constexpr void data(std::tuple<Uses...> *) {
+            constexpr uint8_t read = Effects<Ins>::read;
+            constexpr uint8_t write = Effects<Ins>::write;
+            constexpr bool forced = Effects<Ins>::forced;
+            constexpr size_t count = sizeof...(Uses);
+            constexpr size_t nodes =
+                    (size_t(0) + ... + Abstract<typename Uses::Operand>::nodes);
+            if (nodes > residualNodes) {
+                bail();
+                return;
+            }
+            constexpr Role roles[] = {Uses::role..., Role::Read};
+            Item item{};
+            item.source = machine.pc;
+            std::array<Arg<T>, count + 1> args{};
+            size_t node = 0;
+            size_t j = 0;
+            ((args[j++] = Abstract<typename Uses::Operand>::eval(
+                      *this, item, node, Uses::role != Role::Read),
+              node += Abstract<typename Uses::Operand>::nodes),
+             ...);
+            for (size_t k = 0; k < count; k++) {
+                if (args[k].failed) {
+                    fail(args[k].failure);
+                    return;
+                }
+            }
+            bool dynamic = forced || !flagsKnown(read);
+            for (size_t k = 0; k < count; k++) {
+                if (roles[k] != Role::Write && !args[k].known) {
+                    dynamic = true;
+                }
+                if (roles[k] != Role::Read && !located(args[k])) {
+                    dynamic = true;
+                }
+            }
+            if (!dynamic) {
+                std::array<T, count + 1> old{};
+                for (size_t k = 0; k < count; k++) {
+                    if (roles[k] != Role::Read) {
+                        old[k] = place(args[k]);
+                    }
+                }
+                std::array<bool, flagCount> before{};
+                for (size_t f = 0; f < flagCount; f++) {
+                    before[f] = flag(machine, f);
+                }
+                InstructionEvaluator<Machine, Origin, Ins>::evaluate(machine);
+                for (size_t k = 0; k < count; k++) {
+                    if (roles[k] != Role::Read) {
+                        written(status(args[k]), old[k], place(args[k]));
+                    }
+                }
+                for (size_t f = 0; f < flagCount; f++) {
+                    if (write >> f & 1) {
+                        flags[f] = flags[f] == Known::Synced &&
+                                                   before[f] == flag(machine, f)
+                                           ? Known::Synced
+                                           : Known::Static;
+                    }
+                }
+            } else {
+                bool anywhere = false;
+                for (size_t k = 0; k < count; k++) {
+                    anywhere |= args[k].where == Where::Anywhere;
+                }
+                if (anywhere) {
+                    syncMemory();
+                }
+                for (size_t k = 0; k < count; k++) {
+                    if (roles[k] == Role::ReadWrite) {
+                        sync(args[k]);
+                    }
+                }
+                syncFlags(read);
+                emit(item);
+                for (size_t k = 0; k < count; k++) {
+                    if (roles[k] != Role::Read) {
+                        forget(args[k]);
+                    }
+                }
+                for (size_t f = 0; f < flagCount; f++) {
+                    if (write >> f & 1) {
+                        flags[f] = Known::Dynamic;
+                    }
+                }
+            }
+            machine.pc++;
+        }
+
+        template <uint64_t key, typename value>
+        constexpr void execute(D<key, value> *) {
+            machine.pc++;
+        }
+
+        template <uint64_t id>
+        constexpr void execute(Label<id> *) {
+            visitLabel();
+        }
+
+        template <uint64_t label>
+        constexpr void execute(Jmp<label> *) {
+            machine.pc = LabelAddresses<Origin>::template address<label>();
+        }
+
+        template <Cc cc, uint64_t label>
+        constexpr void execute(Jcc<cc, label> *) {
+            constexpr size_t target =
+                    LabelAddresses<Origin>::template address<label>();
+            if (flagsKnown(conditionFlags(cc))) {
+                machine.pc = holds(cc, machine) ? target : machine.pc + 1;
+                return;
+            }
+            syncFlags(conditionFlags(cc));
+            size_t v = branch(target);
+            if (v == none || !result.ok) {
+                return;
+            }
+            transition(v);
+            Item item{};
+            item.source = machine.pc;
+            item.targets[0] = v;
+            item.targetCount = 1;
+            emit(item);
+            machine.pc++;
+        }
+
+        template <typename Index, uint64_t... labels>
+        constexpr void execute(JmpTable<Index, labels...> *) {
+            constexpr size_t targets[] = {
+                    LabelAddresses<Origin>::template address<labels>()..., 0};
+            constexpr size_t count = sizeof...(labels);
+            if (Abstract<Index>::nodes > residualNodes || count > residualTargets) {
+                bail();
+                return;
+            }
+            Item item{};
+            item.source = machine.pc;
+            auto arg = Abstract<Index>::eval(*this, item, 0, false);
+            if (arg.failed) {
+                fail(arg.failure);
+                return;
+            }
+            if (arg.known) {
+                size_t index = toAddress<Machine>(static_cast<U>(arg.value));
+                if (index >= count) {
+                    fail(Failure::TableIndex);
+                    return;
+                }
+                machine.pc = targets[index];
+                return;
+            }
+            if (arg.where == Where::Anywhere) {
+                syncMemory();
+            }
+            uint8_t need = 0;
+            for (size_t i = 0; i < count; i++) {
+                item.targets[i] = variantFor(targets[i]);
+                if (!result.ok) {
+                    return;
+                }
+                need |= flagNeed(item.targets[i]);
+            }
+            syncFlags(need);
+            for (size_t i = 0; i < count; i++) {
+                syncFor(item.targets[i]);
+            }
+            item.targetCount = count;
+            item.ends = true;
+            emit(item);
+            stop = true;
+        }
+
+        template <typename Src>
+        constexpr void execute(JmpInd<Src> *) {
+            if (Abstract<Src>::nodes > residualNodes) {
+                bail();
+                return;
+            }
+            Item item{};
+            auto arg = Abstract<Src>::eval(*this, item, 0, false);
+            if (arg.failed) {
+                fail(arg.failure);
+                return;
+            }
+            if (!arg.known) {
+                bail();
+                return;
+            }
+            size_t target = toAddress<Machine>(static_cast<U>(arg.value));
+            if (!LabelAddresses<Origin>::isLabelAt(target)) {
+                fail(Failure::JumpTarget);
+                return;
+            }
+            machine.pc = target;
+        }
+
+        template <uint64_t label>
+        constexpr void execute(Call<label> *) {
+            size_t returnAddress = machine.pc + 1;
+            if (static_cast<size_t>(static_cast<T>(returnAddress)) !=
+                returnAddress) {
+                fail(Failure::ReturnRange);
+                return;
+            }
+            if (machine.sp == machine.decCount) {
+                fail(Failure::Overflow);
+                return;
+            }
+            machine.sp--;
+            store(machine.sp, static_cast<T>(returnAddress));
+            machine.pc = LabelAddresses<Origin>::template address<label>();
+        }
+
+        constexpr void execute(Ret *) {
+            if (machine.sp == memorySize) {
+                fail(Failure::Underflow);
+                return;
+            }
+            if (cells[machine.sp] == Known::Dynamic) {
+                bail();
+                return;
+            }
+            size_t target = toAddress<Machine>(
+                    static_cast<U>(machine.memoryBlocks[machine.sp]));
+            store(machine.sp++, T());
+            if (!LabelAddresses<Origin>::isReturnAddress(target)) {
+                fail(Failure::ReturnTarget);
+                return;
+            }
+            machine.pc = target;
+        }
+
+        // Push i Pop danych dynamicznych zostają jako Mov pod adres na stosie.
+        template <typename Src>
+        constexpr void execute(Push<Src> *) {
+            if (Abstract<Src>::nodes > residualNodes) {
+                bail();
+                return;
+            }
+            Item item{};
+            item.source = machine.pc;
+            auto arg = Abstract<Src>::eval(*this, item, 0, false);
+            if (arg.failed) {
+                fail(arg.failure);
+                return;
+            }
+            if (machine.sp == machine.decCount) {
+                fail(Failure::Overflow);
+                return;
+            }
+            machine.sp--;
+            if (arg.known) {
+                store(machine.sp, arg.value);
+            } else {
+                if (arg.where == Where::Anywhere) {
+                    syncMemory();
+                }
+                item.index = machine.sp;
+                emit(item);
+                cells[machine.sp] = Known::Dynamic;
+            }
+            machine.pc++;
+        }
+
+        template <typename Dst>
+        constexpr void execute(Pop<Dst> *) {
+            if (Abstract<Dst>::nodes > residualNodes) {
+                bail();
+                return;
+            }
+            if (machine.sp == memorySize) {
+                fail(Failure::Underflow);
+                return;
+            }
+            Item item{};
+            item.source = machine.pc;
+            auto arg = Abstract<Dst>::eval(*this, item, 0, true);
+            if (arg.failed) {
+                fail(arg.failure);
+                return;
+            }
+            // Pop zeruje zdjętą komórkę przed zapisem do Dst, a jedno Mov
+            // w programie rezydualnym nie zrobi tego przed zapisem pod
+            // nieznany adres.
+            if (arg.where == Where::Anywhere) {
+                bail();
+                return;
+            }
+            size_t top = machine.sp++;
+            bool known = cells[top] != Known::Dynamic;
+            T value = machine.memoryBlocks[top];
+            if (known && located(arg)) {
+                store(top, T());
+                T old = place(arg);
+                place(arg) = value;
+                written(status(arg), old, value);
+            } else {
+                item.index = top;
+                item.known = known;
+                item.value = value;
+                emit(item);
+                if (known) {
+                    store(top, T());
+                } else {
+                    machine.memoryBlocks[top] = T();
+                    cells[top] = Known::Static;
+                }
+                forget(arg);
+            }
+            machine.pc++;
+        }
+
+        // Instrukcje na danych.
+        template <typename Ins>
+        constexpr void execute(Ins *) {
+            data<Ins>();
+        }
+
+        // CMov o znanym warunku to Mov albo nic.
+        template <Cc cc, typename Dst, typename Src>
+        constexpr void execute(CMov<cc, Dst, Src> *) {
+            if (!flagsKnown(conditionFlags(cc))) {
+                data<CMov<cc, Dst, Src>>();
+            } else if (holds(cc, machine)) {
+                size_t count = result.count;
+                data<Mov<Dst, Src>>();
+                if (result.count > count) {
+                    result.items[result.count - 1].known = true;
+                }
+            } else {
+                machine.pc++;
+            }
+        }
+
+        constexpr void execute(Fence *) {
+            machine.pc++;
+        }
+
+        /* Porządki w kodzie rezydualnym */
+
+        // Usuwa skoki do następnej instrukcji, kod za bezwarunkowym skokiem
+        // aż do etykiety i etykiety, do których nic nie skacze. Skoki do
+        // etykiety stojącej tuż przed inną etykietą albo końcem programu idą
+        // od razu dalej.
+        constexpr void cleanup() {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (size_t i = 0; i < result.count; i++) {
+                    if (result.items[i].kind != Emit::Label ||
+                        (i + 1 < result.count &&
+                         result.items[i + 1].kind != Emit::Label)) {
+                        continue;
+                    }
+                    size_t next = i + 1 == result.count
+                                          ? endVariant
+                                          : result.items[i + 1].index;
+                    for (size_t j = 0; j < result.count; j++) {
+                        Item &item = result.items[j];
+                        for (size_t t = 0; t < item.targetCount; t++) {
+                            if (item.targets[t] == result.items[i].index) {
+                                item.targets[t] = next;
+                                changed = true;
+                            }
+                        }
+                    }
+                }
+                std::array<bool, maxVariants> referenced{};
+                for (size_t i = 0; i < result.count; i++) {
+                    const Item &item = result.items[i];
+                    for (size_t t = 0; t < item.targetCount; t++) {
+                        if (item.targets[t] != endVariant) {
+                            referenced[item.targets[t]] = true;
+                        }
+                    }
+                }
+                size_t kept = 0;
+                bool reachable = true;
+                for (size_t i = 0; i < result.count; i++) {
+                    Item item = result.items[i];
+                    bool drop = false;
+                    if (item.kind == Emit::Label) {
+                        drop = !referenced[item.index];
+                        reachable = reachable || !drop;
+                    } else {
+                        drop = !reachable;
+                    }
+                    if (!drop && item.kind == Emit::Jump) {
+                        size_t next = i + 1;
+                        while (next < result.count &&
+                               result.items[next].kind == Emit::Label &&
+                               !referenced[result.items[next].index]) {
+                            next++;
+                        }
+                        drop = next < result.count
+                                       ? result.items[next].kind == Emit::Label &&
+                                                 result.items[next].index ==
+                                                         item.targets[0]
+                                       : item.targets[0] == endVariant;
+                    }
+                    if (!drop && item.ends) {
+                        reachable = false;
+                    }
+                    if (drop) {
+                        changed = true;
+                    } else {
+                        result.items[kept++] = item;
+                    }
+                }
+                result.count = kept;
+            }
+        }
+    };
+
+    template <typename S, typename Origin, typename Dyn, size_t limit>
+    struct Specialization {
+        using Evaluator = PartialEvaluator<S, Origin, Dyn, limit>;
+        using Instructions = Origin;
+
+        static constexpr S initial = Evaluator::parse();
+        static constexpr typename Evaluator::Result result = Evaluator::run();
+    };
+
+    /* Budowa typu programu rezydualnego */
+
+    template <typename Holder, size_t i, size_t node, typename X,
+            Rewrite rewrite = Holder::result.items[i].rewrite[node]>
+    struct RewriteOperand {
+        using type = X;
+    };
+
+    template <typename Holder, size_t i, size_t node, typename X>
+    struct RewriteOperand<Holder, i, node, X, Rewrite::Value> {
+        using type = Num<Holder::result.items[i].values[node]>;
+    };
+
+    template <typename Holder, size_t i, size_t node, typename X>
+    struct RewriteOperand<Holder, i, node, X, Rewrite::Index> {
+        using type = Num<Holder::result.items[i].addresses[node]>;
+    };
+
+    template <typename Holder, size_t i, size_t node, typename X>
+    struct RewriteOperand<Holder, i, node, X, Rewrite::Address> {
+        using type = Mem<Num<Holder::result.items[i].addresses[node]>>;
+    };
+
+    template <typename Holder, size_t i, size_t node, typename Base,
+            typename Index, std::ptrdiff_t scale, std::ptrdiff_t offset>
+    struct RewriteOperand<Holder, i, node, Mem<Base, Index, scale, offset>,
+            Rewrite::Keep> {
+        using type = Mem<typename RewriteOperand<Holder, i, node + 1, Base>::type,
+                typename RewriteOperand<Holder, i,
+                        node + 1 + Abstract<Base>::nodes, Index>::type,
+                scale, offset>;
+    };
+
+    template <typename Holder, size_t i, template <typename...> class Op,
+            typename Sequence, typename... Args>
+    struct RewriteArgs;
+
+    template <typename Holder, size_t i, template <typename...> class Op,
+            size_t... js, typename... Args>
+    struct RewriteArgs<Holder, i, Op, std::index_sequence<js...>, Args...> {
+        using type = Op<typename RewriteOperand<Holder, i,
+                nodeOffsets<Args...>()[js], Args>::type...>;
+    };
+
+    template <typename Holder, size_t i, typename Ins>
+    struct RewriteInstruction;
+
+    template <typename Holder, size_t i, template <typename...> class Op,
+            typename... Args>
+    struct RewriteInstruction<Holder, i, Op<Args...>> {
+        using type = typename RewriteArgs<Holder, i, Op,
+                std::index_sequence_for<Args...>, Args...>::type;
+    };
+
+    template <typename Holder, size_t i, typename Src>
+    struct RewriteInstruction<Holder, i, Push<Src>> {
+        using type = Mov<Mem<Num<Holder::result.items[i].index>>,
+                typename RewriteOperand<Holder, i, 0, Src>::type>;
+    };
+
+    template <typename Holder, size_t i, typename Dst>
+    struct RewriteInstruction<Holder, i, Pop<Dst>> {
+        static constexpr auto &item = Holder::result.items[i];
+
+        using type = Mov<typename RewriteOperand<Holder, i, 0, Dst>::type,
+                std::conditional_t<item.known, Num<item.value>,
+                        Mem<Num<item.index>>>>;
+    };
+
+    // CMov o znanym, spełnionym warunku jest zapisywane jako Mov.
+    template <typename Holder, size_t i, Cc cc, typename Dst, typename Src>
+    struct RewriteInstruction<Holder, i, CMov<cc, Dst, Src>> {
+        using Dst1 = typename RewriteOperand<Holder, i, 0, Dst>::type;
+        using Src1 = typename RewriteOperand<Holder, i, Abstract<Dst>::nodes,
+                Src>::type;
+
+        using type = std::conditional_t<Holder::result.items[i].known,
+                Mov<Dst1, Src1>, CMov<cc, Dst1, Src1>>;
+    };
+
+    template <typename Holder, size_t i, typename Dst, size_t port>
+    struct RewriteInstruction<Holder, i, In<Dst, port>> {
+        using type = In<typename RewriteOperand<Holder, i, 0, Dst>::type, port>;
+    };
+
+    template <typename Holder, size_t i, size_t port, typename Src>
+    struct RewriteInstruction<Holder, i, Out<port, Src>> {
+        using type = Out<port, typename RewriteOperand<Holder, i, 0, Src>::type>;
+    };
+
+    template <typename Holder, size_t i, Cc cc, uint64_t label>
+    struct RewriteInstruction<Holder, i, Jcc<cc, label>> {
+        using type = Jcc<cc, variantLabel(Holder::result.items[i].targets[0])>;
+    };
+
+    template <typename Holder, size_t i, typename Index, uint64_t... labels>
+    struct RewriteInstruction<Holder, i, JmpTable<Index, labels...>> {
+        template <typename Sequence>
+        struct Targets;
+
+        template <size_t... js>
+        struct Targets<std::index_sequence<js...>> {
+            using type = JmpTable<typename RewriteOperand<Holder, i, 0,
+                    Index>::type,
+                    variantLabel(Holder::result.items[i].targets[js])...>;
+        };
+
+        using type = typename Targets<
+                std::make_index_sequence<sizeof...(labels)>>::type;
+    };
+
+    template <typename Holder, size_t i,
+            Emit kind = Holder::result.items[i].kind>
+    struct EmitItem;
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::Original> {
+        using Source = std::tuple_element_t<Holder::result.items[i].source,
+                typename Holder::Instructions>;
+
+        using type = typename RewriteInstruction<Holder, i,
+                typename ResolveLabels<typename Holder::Instructions,
+                        Source>::type>::type;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::SetCell> {
+        using type = Mov<Mem<Num<Holder::result.items[i].index>>,
+                Num<Holder::result.items[i].value>>;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::SetRegister> {
+        using type = Mov<Reg<Holder::result.items[i].index>,
+                Num<Holder::result.items[i].value>>;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::Compare> {
+        using type = Cmp<Num<Holder::result.items[i].value>,
+                Num<Holder::result.items[i].other>>;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::Label> {
+        using type = Label<residualLabel(Holder::result.items[i].index)>;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::Jump> {
+        using type = Jmp<variantLabel(Holder::result.items[i].targets[0])>;
+    };
+
+    template <typename Holder, size_t i>
+    struct EmitItem<Holder, i, Emit::Fail> {
+        using type = Fail<static_cast<Failure>(Holder::result.items[i].index)>;
+    };
+};
+
+template <internal::Failure failure>
+struct isProperInstruction<internal::Fail<failure>> : public std::true_type {};
+
+template <typename S, typename InstructionsOrigin, internal::Failure failure>
+struct InstructionEvaluator<S, InstructionsOrigin, internal::Fail<failure>> {
+    constexpr static void evaluate(S &) {
+        using internal::Failure;
+        switch (failure) {
+            case Failure::Memory:
+                throw std::out_of_range("Memory address out of range");
+            case Failure::Id:
+                throw std::invalid_argument("Nonexisting ID");
+            case Failure::Overflow:
+                throw std::invalid_argument("Stack overflow");
+            case Failure::Underflow:
+                throw std::invalid_argument("Stack underflow");
+            case Failure::ReturnRange:
+                throw std::invalid_argument("Return address out of range");
+            case Failure::ReturnTarget:
+                throw std::invalid_argument(
+                        "Return target is not a return address");
+            case Failure::JumpTarget:
+                throw std::invalid_argument("Jump target is not a label");
+            case Failure::TableIndex:
+                throw std::out_of_range("Jump table index out of range");
+        }
+    }
+};
+
+template <typename Machine, typename ProgramIns, typename Dyn = Dynamic<>,
+        std::size_t limit = 1000000>
+struct Specialize;
+
+template <std::size_t memorySize, typename T, typename... Instructions,
+        uint64_t... ids, std::size_t limit>
+struct Specialize<Computer<memorySize, T>, Program<Instructions...>,
+        Dynamic<ids...>, limit> {
+private:
+    using Holder = internal::Specialization<
+            internal::TraceState<memorySize, T>, std::tuple<Instructions...>,
+            Dynamic<ids...>, limit>;
+
+    // Deklaracje P z wartościami początkowymi, w tej samej kolejności, więc
+    // zmienne mają te same adresy.
+    template <typename Sequence>
+    struct Declarations;
+
+    template <size_t... is>
+    struct Declarations<std::index_sequence<is...>> {
+        using type = Program<D<Holder::initial.declarationIDs[is],
+                Num<Holder::initial.memoryBlocks[is]>>...>;
+    };
+
+    template <typename Sequence>
+    struct Code;
+
+    template <size_t... is>
+    struct Code<std::index_sequence<is...>> {
+        using type = Program<typename internal::EmitItem<Holder, is>::type...>;
+    };
+
+    template <bool, typename = void>
+    struct Build {
+        using type = Program<Instructions...>;
+    };
+
+    template <typename Dummy>
+    struct Build<true, Dummy> {
+        using type = typename ProgramCat<
+                typename Declarations<std::make_index_sequence<
+                        Holder::initial.decCount>>::type,
+                typename Code<std::make_index_sequence<
+                        Holder::result.count>>::type,
+                Program<Label<internal::residualEnd>>>::type;
+    };
+
+public:
+    using type = typename Build<Holder::result.ok>::type;
+};
+
+#endif  // ASSEMBLER_SPECIALIZE_H
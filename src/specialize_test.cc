@@ -0,0 +1,217 @@
+#include "specialize.h"
+#include <array>
+
+template <class T, std::size_t N>
+constexpr bool compare(std::array<T, N> const &arg1,
+                       std::array<T, N> const &arg2) {
+    for (size_t i = 0; i < N; ++i)
+        if (arg1[i] != arg2[i]) return false;
+    return true;
+}
+
+// Stała k = 1 + 2 + ... + 20 jest liczona z danych znanych w czasie
+// kompilacji, dopiero potem program czyta port.
+using tmpasm_scaled = Program<
+        D<Id("k"), Num<0>>,
+        D<Id("i"), Num<20>>,
+        D<Id("x"), Num<0>>,
+        Label<Id("sum")>,
+        Add<Mem<Lea<Id("k")>>, Mem<Lea<Id("i")>>>,
+        Dec<Mem<Lea<Id("i")>>>,
+        Jnz<Id("sum")>,
+        Label<Id("loop")>,
+        In<Mem<Lea<Id("x")>>, 0>,
+        Jz<Id("end")>,
+        Add<Mem<Lea<Id("x")>>, Mem<Lea<Id("k")>>>,
+        Out<0, Mem<Lea<Id("x")>>>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+// Przerwanie wewnątrz podprogramu -- na stosie zostaje adres powrotu,
+// a flagi ustawione przed In są potem sprawdzane.
+using tmpasm_nested = Program<
+        D<Id("x"), Num<0>>,
+        Mov<Reg<3>, Num<-7>>,
+        Call<Id("read")>,
+        Out<0, Mem<Lea<Id("x")>>>,
+        Jmp<Id("end")>,
+        Label<Id("read")>,
+        Cmp<Reg<3>, Num<1>>,
+        Mov<Mem<Lea<Id("x")>>, Mem<Lea<Id("x")>>>,
+        In<Mem<Lea<Id("x")>>, 0>,
+        CMov<Cc::L, Mem<Lea<Id("x")>>, Reg<3>>,
+        Ret,
+        Label<Id("end")>>;
+
+// Deklaracje, a zaraz za nimi pętla czytająca port. Przesunięcie liczone
+// w każdym obrocie z danych statycznych znika z pętli.
+using tmpasm_stream = Program<
+        D<Id("base"), Num<5>>,
+        D<Id("x"), Num<0>>,
+        Label<Id("loop")>,
+        In<Mem<Lea<Id("x")>>, 0>,
+        Jz<Id("end")>,
+        Mov<Reg<1>, Mem<Lea<Id("base")>>>,
+        Add<Reg<1>, Num<3>>,
+        Add<Mem<Lea<Id("x")>>, Reg<1>>,
+        Out<0, Mem<Lea<Id("x")>>>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+using Machine = Computer<4, int>;
+using InputTape = Tape<int, 3, 3>;
+
+template <typename P>
+struct Run {
+    std::array<int, 4> memory;
+    std::array<int, 3> output;
+    size_t steps;
+};
+
+template <typename P, int first = 1>
+constexpr Run<P> run() {
+    InputTape tape({first, 2, 3});
+    StreamState<4, int, InputTape> s(tape);
+    InitialInstructionsParsing<decltype(s), typename P::Instructions>::evaluate(s);
+    size_t steps = InstructionsRunner<decltype(s),
+            typename P::Instructions>::run(s, 1000000);
+    return Run<P>{s.memoryBlocks, tape.output, steps};
+}
+
+template <typename P>
+constexpr size_t length() {
+    return std::tuple_size<typename P::Instructions>::value;
+}
+
+template <typename P, typename Residual, int first = 1>
+constexpr bool equivalent() {
+    return compare(run<P, first>().memory, run<Residual, first>().memory) &&
+           compare(run<P, first>().output, run<Residual, first>().output);
+}
+
+using scaled = Specialize<Machine, tmpasm_scaled>::type;
+using scaled_dynamic =
+        Specialize<Machine, tmpasm_scaled, Dynamic<Id("i")>>::type;
+using nested = Specialize<Machine, tmpasm_nested>::type;
+using stream = Specialize<Machine, tmpasm_stream>::type;
+
+using tmpasm_static = Program<
+        D<Id("k"), Num<0>>,
+        D<Id("i"), Num<100>>,
+        Label<Id("sum")>,
+        Add<Mem<Lea<Id("k")>>, Mem<Lea<Id("i")>>>,
+        Dec<Mem<Lea<Id("i")>>>,
+        Jnz<Id("sum")>>;
+
+using folded = Specialize<Machine, tmpasm_static>::type;
+
+// Cmp adresu zmiennej (size_t) z komórką (int): flagi zależą od typów
+// argumentów, więc Lea w programie rezydualnym musi zostać stałą size_t.
+using tmpasm_lea_compare = Program<
+        D<Id("a"), Num<0>>,
+        D<Id("f"), Num<0>>,
+        In<Mem<Lea<Id("a")>>, 0>,
+        Cmp<Lea<Id("a")>, Mem<Lea<Id("a")>>>,
+        Js<Id("y")>,
+        Jmp<Id("e")>,
+        Label<Id("y")>,
+        Mov<Mem<Lea<Id("f")>>, Num<1>>,
+        Label<Id("e")>>;
+
+using lea_compare = Specialize<Machine, tmpasm_lea_compare>::type;
+
+// Łańcuch bloków: etykieta, zapis stałej do k i -- gdy jump -- skok zależny
+// od wejścia do następnej etykiety, a bez niego zapis do rejestru.
+template <bool jump, typename Blocks>
+struct Chain;
+
+template <bool jump, size_t... i>
+struct Chain<jump, std::index_sequence<i...>> {
+    static constexpr uint64_t end = 1000 + sizeof...(i) / 3;
+
+    using type = Program<
+            D<Id("x"), Num<0>>,
+            D<Id("k"), Num<0>>,
+            In<Mem<Lea<Id("x")>>, 0>,
+            std::conditional_t<i % 3 == 0, Label<1000 + i / 3>,
+                    std::conditional_t<i % 3 == 1,
+                            Mov<Mem<Lea<Id("k")>>, Num<int(i / 3)>>,
+                            std::conditional_t<jump, Jz<1000 + i / 3 + 1>,
+                                    Mov<Reg<1>, Num<int(i / 3)>>>>>...,
+            Label<end>,
+            Out<0, Mem<Lea<Id("k")>>>>;
+};
+
+// 70 bloków -- więcej etykiet niż 64 wersje.
+template <bool jump>
+using tmpasm_chain = typename Chain<jump, std::make_index_sequence<3 * 70>>::type;
+
+using chain_fallthrough = Specialize<Machine, tmpasm_chain<false>>::type;
+using chain_jumps = Specialize<Machine, tmpasm_chain<true>>::type;
+
+int main() {
+    static_assert(compare(run<tmpasm_scaled>().output,
+                          std::array<int, 3>({211, 212, 213})),
+                  "Failed [tmpasm_scaled].");
+    static_assert(equivalent<tmpasm_scaled, scaled>(), "Failed [scaled].");
+    static_assert(run<scaled>().steps * 2 < run<tmpasm_scaled>().steps,
+                  "Failed [scaled steps].");
+    static_assert(length<scaled>() < length<tmpasm_scaled>(),
+                  "Failed [scaled length].");
+
+    // Pętla zależna od zmiennej dynamicznej zostaje -- bez wyszukiwania
+    // zmiennych i bez dodatkowych kroków.
+    static_assert(equivalent<tmpasm_scaled, scaled_dynamic>(),
+                  "Failed [scaled_dynamic].");
+    static_assert(run<scaled_dynamic>().steps <= run<tmpasm_scaled>().steps,
+                  "Failed [scaled_dynamic steps].");
+
+    static_assert(equivalent<tmpasm_nested, nested>(), "Failed [nested].");
+    static_assert(length<nested>() < length<tmpasm_nested>(),
+                  "Failed [nested length].");
+
+    static_assert(equivalent<tmpasm_stream, stream>(), "Failed [stream].");
+    static_assert(length<stream>() < length<tmpasm_stream>(),
+                  "Failed [stream length].");
+    static_assert(run<stream>().steps < run<tmpasm_stream>().steps,
+                  "Failed [stream steps].");
+
+    // Ret pod adres zależny od wejścia -- program zostaje bez zmian.
+    using unchanged = Program<
+            D<Id("r"), Num<0>>,
+            In<Mem<Lea<Id("r")>>, 0>,
+            Push<Mem<Lea<Id("r")>>>,
+            Ret>;
+    static_assert(std::is_same<Specialize<Machine, unchanged>::type,
+                          unchanged>(), "Failed [unchanged].");
+
+    // Błąd w osiągalnym kodzie zostaje w programie rezydualnym.
+    using failing = Program<Mov<Mem<Num<9>>, Num<1>>>;
+    static_assert(length<Specialize<Machine, failing>::type>() == 2,
+                  "Failed [failing].");
+
+    // Program bez danych dynamicznych zwija się w całości.
+    static_assert(compare(Machine::boot<folded>(),
+                          Machine::boot<tmpasm_static>()),
+                  "Failed [folded].");
+    static_assert(run<folded>().steps < 16, "Failed [folded steps].");
+
+    static_assert(run<tmpasm_lea_compare, -1>().memory[1] == 1,
+                  "Failed [tmpasm_lea_compare].");
+    static_assert(equivalent<tmpasm_lea_compare, lea_compare, -1>(),
+                  "Failed [lea_compare].");
+    static_assert(equivalent<tmpasm_lea_compare, lea_compare>(),
+                  "Failed [lea_compare positive].");
+
+    // Etykiety, do których nic nie skacze, nie tworzą wersji.
+    static_assert(equivalent<tmpasm_chain<false>, chain_fallthrough>(),
+                  "Failed [chain_fallthrough].");
+    static_assert(length<chain_fallthrough>() < 16,
+                  "Failed [chain_fallthrough length].");
+
+    // Limit wersji rośnie z liczbą celów skoków.
+    static_assert(equivalent<tmpasm_chain<true>, chain_jumps>(),
+                  "Failed [chain_jumps].");
+    static_assert(length<chain_jumps>() < length<tmpasm_chain<true>>(),
+                  "Failed [chain_jumps length].");
+}
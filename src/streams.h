@@ -0,0 +1,188 @@
+#ifndef ASSEMBLER_STREAMS_H
+#define ASSEMBLER_STREAMS_H
+
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "computer.h"
+
+// Strumienie dla portów In/Out w czasie wykonania. Pliki zawierają surowe
+// słowa typu T w kolejności bajtów maszyny.
+
+namespace internal {
+    [[noreturn]] inline void throwSystemError(const std::string &what) {
+        throw std::system_error(errno, std::generic_category(), what);
+    }
+};
+
+// Plik wejściowy odwzorowany w pamięci -- słowa są czytane bezpośrednio
+// z odwzorowania, bez kopiowania do bufora. Plik, którego długość nie jest
+// wielokrotnością sizeof(T), jest odrzucany.
+template <typename T>
+class MappedInput {
+public:
+    explicit MappedInput(const std::string &path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            internal::throwSystemError("open " + path);
+        }
+        struct stat info {};
+        if (::fstat(fd, &info) < 0) {
+            ::close(fd);
+            internal::throwSystemError("fstat " + path);
+        }
+        bytes = static_cast<size_t>(info.st_size);
+        if (bytes % sizeof(T) != 0) {
+            ::close(fd);
+            throw std::invalid_argument("Truncated input");
+        }
+        words = bytes / sizeof(T);
+        if (bytes > 0) {
+            void *mapped = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                ::close(fd);
+                internal::throwSystemError("mmap " + path);
+            }
+            ::madvise(mapped, bytes, MADV_SEQUENTIAL);
+            data = static_cast<const T *>(mapped);
+        }
+        ::close(fd);
+    }
+
+    MappedInput(const MappedInput &) = delete;
+    MappedInput &operator=(const MappedInput &) = delete;
+
+    ~MappedInput() {
+        if (data != nullptr) {
+            ::munmap(const_cast<T *>(data), bytes);
+        }
+    }
+
+    bool read(T &value) {
+        if (position == words) {
+            return false;
+        }
+        value = data[position++];
+        return true;
+    }
+
+private:
+    const T *data = nullptr;
+    size_t bytes = 0;
+    size_t words = 0;
+    size_t position = 0;
+};
+
+// Plik wyjściowy zapisywany przez bufor o stałej wielkości. Po zakończeniu
+// zapisu trzeba wywołać close().
+template <typename T>
+class BufferedOutput {
+public:
+    static constexpr size_t bufferWords = (1 << 16) / sizeof(T);
+
+    explicit BufferedOutput(const std::string &path)
+            : fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)) {
+        if (fd < 0) {
+            internal::throwSystemError("open " + path);
+        }
+        buffer.reserve(bufferWords);
+    }
+
+    BufferedOutput(const BufferedOutput &) = delete;
+    BufferedOutput &operator=(const BufferedOutput &) = delete;
+
+    // Tylko awaryjnie -- błąd zapisu ostatniego bufora jest tu pomijany.
+    // Wynik należy zamknąć przez close(), które zgłasza błędy.
+    ~BufferedOutput() {
+        if (fd < 0) {
+            return;
+        }
+        try {
+            flush();
+        } catch (...) {
+        }
+        ::close(fd);
+    }
+
+    void write(T value) {
+        buffer.push_back(value);
+        if (buffer.size() == bufferWords) {
+            flush();
+        }
+    }
+
+    void flush() {
+        if (fd < 0) {
+            throw std::logic_error("Output already closed");
+        }
+        const char *bytes = reinterpret_cast<const char *>(buffer.data());
+        size_t left = buffer.size() * sizeof(T);
+        while (left > 0) {
+            ssize_t done = ::write(fd, bytes, left);
+            if (done < 0) {
+                if (errno == EINTR) continue;
+                internal::throwSystemError("write");
+            }
+            bytes += done;
+            left -= static_cast<size_t>(done);
+        }
+        buffer.clear();
+    }
+
+    // Zapisuje resztę bufora i zamyka plik; zgłasza błąd zapisu i zamknięcia.
+    void close() {
+        flush();
+        int closing = fd;
+        fd = -1;
+        if (::close(closing) < 0) {
+            internal::throwSystemError("close");
+        }
+    }
+
+private:
+    int fd;
+    std::vector<T> buffer;
+};
+
+// Przypisanie strumieni do portów, do użycia z Computer::boot<P>(ports).
+template <typename T, std::size_t portCount = 8>
+class StreamPorts {
+public:
+    void bindInput(size_t port, MappedInput<T> &input) {
+        inputs.at(port) = &input;
+    }
+
+    void bindOutput(size_t port, BufferedOutput<T> &output) {
+        outputs.at(port) = &output;
+    }
+
+    bool read(size_t port, T &value) {
+        if (port >= portCount || inputs[port] == nullptr) {
+            throw std::invalid_argument("Unbound port");
+        }
+        return inputs[port]->read(value);
+    }
+
+    void write(size_t port, T value) {
+        if (port >= portCount || outputs[port] == nullptr) {
+            throw std::invalid_argument("Unbound port");
+        }
+        outputs[port]->write(value);
+    }
+
+private:
+    std::array<MappedInput<T> *, portCount> inputs{};
+    std::array<BufferedOutput<T> *, portCount> outputs{};
+};
+
+#endif  // ASSEMBLER_STREAMS_H
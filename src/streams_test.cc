@@ -0,0 +1,84 @@
+#include "streams.h"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+// Ten sam program co w test.cc, tym razem na plikach.
+using tmpasm_double = Program<
+        D<Id("x"), Num<0>>,
+        D<Id("n"), Num<0>>,
+        Label<Id("loop")>,
+        In<Mem<Lea<Id("x")>>, 0>,
+        Jz<Id("end")>,
+        Add<Mem<Lea<Id("x")>>, Mem<Lea<Id("x")>>>,
+        Out<1, Mem<Lea<Id("x")>>>,
+        Inc<Mem<Lea<Id("n")>>>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+int main() {
+    const std::string inPath = "streams_test.in";
+    const std::string outPath = "streams_test.out";
+    const int count = 100000;
+
+    {
+        std::vector<int> words(count);
+        for (int i = 0; i < count; i++) words[i] = i;
+        std::ofstream in(inPath, std::ios::binary);
+        in.write(reinterpret_cast<const char *>(words.data()),
+                 count * sizeof(int));
+    }
+
+    std::array<int, 2> memory;
+    {
+        MappedInput<int> input(inPath);
+        BufferedOutput<int> output(outPath);
+        StreamPorts<int> ports;
+        ports.bindInput(0, input);
+        ports.bindOutput(1, output);
+        memory = Computer<2, int>::boot<tmpasm_double>(ports);
+        output.close();
+    }
+
+    std::vector<int> result(count);
+    std::ifstream out(outPath, std::ios::binary);
+    out.read(reinterpret_cast<char *>(result.data()), count * sizeof(int));
+    bool ok = out.gcount() == static_cast<std::streamsize>(count * sizeof(int)) &&
+              memory[1] == count;
+    for (int i = 0; ok && i < count; i++) {
+        ok = result[i] == 2 * i;
+    }
+    std::remove(inPath.c_str());
+    std::remove(outPath.c_str());
+
+    if (!ok) {
+        std::cout << "Failed [streams]." << std::endl;
+        return 1;
+    }
+
+    // Plik z niepełnym ostatnim słowem jest odrzucany.
+    {
+        std::ofstream in(inPath, std::ios::binary);
+        in.write("abc", 3);
+    }
+    try {
+        MappedInput<int> truncated(inPath);
+        std::remove(inPath.c_str());
+        std::cout << "Failed [truncated]." << std::endl;
+        return 1;
+    } catch (const std::invalid_argument &) {
+    }
+    std::remove(inPath.c_str());
+
+    // Błąd zapisu ostatniego bufora zgłasza close().
+    try {
+        BufferedOutput<int> full("/dev/full");
+        full.write(1);
+        full.close();
+        std::cout << "Failed [close]." << std::endl;
+        return 1;
+    } catch (const std::system_error &) {
+    }
+    return 0;
+}
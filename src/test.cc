@@ -110,6 +110,242 @@ using tmpasm_multiplication = Program<
         Jmp<Id("loop")>,
         Label<Id("stop")>>;
 
+using tmpasm_call = Program<
+        D<Id("a"), Num<3>>,
+        D<Id("r"), Num<0>>,
+        Call<Id("add")>,
+        Call<Id("add")>,
+        Jmp<Id("end")>,
+        Label<Id("add")>,
+        Add<Mem<Lea<Id("r")>>, Mem<Lea<Id("a")>>>,
+        Ret,
+        Label<Id("end")>>;
+
+using tmpasm_stack = Program<
+        D<Id("a"), Num<0>>,
+        D<Id("b"), Num<0>>,
+        Push<Num<5>>,
+        Push<Num<7>>,
+        Pop<Mem<Lea<Id("a")>>>,
+        Pop<Mem<Lea<Id("b")>>>>;
+
+// Rekurencja: silnia z a, wynik w r.
+using tmpasm_factorial = Program<
+        D<Id("a"), Num<5>>,
+        D<Id("r"), Num<1>>,
+        Call<Id("fact")>,
+        Jmp<Id("end")>,
+        Label<Id("fact")>,
+        Cmp<Mem<Lea<Id("a")>>, Num<1>>,
+        Jz<Id("base")>,
+        Push<Mem<Lea<Id("a")>>>,
+        Dec<Mem<Lea<Id("a")>>>,
+        Call<Id("fact")>,
+        Pop<Mem<Lea<Id("a")>>>,
+        Mov<Mem<Lea<Id("t")>>, Mem<Lea<Id("r")>>>,
+        Label<Id("mul")>,
+        Dec<Mem<Lea<Id("a")>>>,
+        Jz<Id("base")>,
+        Add<Mem<Lea<Id("r")>>, Mem<Lea<Id("t")>>>,
+        Jmp<Id("mul")>,
+        Label<Id("base")>,
+        Ret,
+        Label<Id("end")>,
+        D<Id("t"), Num<0>>>;
+
+// Pętla wykonująca kilka tysięcy instrukcji.
+using tmpasm_long_loop = Program<
+        D<Id("n"), Num<1000>>,
+        D<Id("s"), Num<0>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("s")>>, Num<2>>,
+        Dec<Mem<Lea<Id("n")>>>,
+        Jz<Id("stop")>,
+        Jmp<Id("loop")>,
+        Label<Id("stop")>>;
+
+// Moduły -- "i" oraz "loop" są lokalne w obu modułach.
+using module_main = Module<Export<>,
+        D<Id("i"), Num<3>>,
+        Label<Id("loop")>,
+        Call<Id("sum")>,
+        Dec<Mem<Lea<Id("i")>>>,
+        Jz<Id("done")>,
+        Jmp<Id("loop")>,
+        Label<Id("done")>,
+        Jmp<Id("halt")>>;
+
+using module_sum = Module<Export<Id("sum"), Id("total")>,
+        D<Id("total"), Num<0>>,
+        D<Id("i"), Num<10>>,
+        Label<Id("sum")>,
+        Add<Mem<Lea<Id("total")>>, Mem<Lea<Id("i")>>>,
+        Jmp<Id("loop")>,
+        Label<Id("loop")>,
+        Ret>;
+
+using module_halt = Module<Export<Id("halt")>,
+        Label<Id("halt")>>;
+
+using tmpasm_linked = Link<module_main, module_sum, module_halt>;
+
+// Podwaja kolejne słowa z portu 0 i zlicza je.
+using tmpasm_double = Program<
+        D<Id("x"), Num<0>>,
+        D<Id("n"), Num<0>>,
+        Label<Id("loop")>,
+        In<Mem<Lea<Id("x")>>, 0>,
+        Jz<Id("end")>,
+        Add<Mem<Lea<Id("x")>>, Mem<Lea<Id("x")>>>,
+        Out<0, Mem<Lea<Id("x")>>>,
+        Inc<Mem<Lea<Id("n")>>>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+constexpr Tape<int, 3, 3> run_double() {
+    Tape<int, 3, 3> tape({1, 2, 3});
+    Computer<2, int>::boot<tmpasm_double>(tape);
+    return tape;
+}
+
+// Pętla na rejestrach, wynik trafia do pamięci dopiero na końcu.
+using tmpasm_registers = Program<
+        Mov<Reg<0>, Num<10>>,
+        Mov<Reg<1>, Num<0>>,
+        Label<Id("loop")>,
+        Add<Reg<1>, Reg<0>>,
+        Dec<Reg<0>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>,
+        Mov<Reg<2>, Num<1>>,
+        Mov<Mem<Reg<2>>, Reg<1>>>;
+
+// Suma co drugiej komórki tablicy (a5, a3, a1) przez adresowanie
+// baza + indeks * skala + przesunięcie.
+using tmpasm_indexed = Program<
+        D<Id("arr"), Num<0>>,
+        D<Id("a1"), Num<1>>,
+        D<Id("a2"), Num<0>>,
+        D<Id("a3"), Num<2>>,
+        D<Id("a4"), Num<0>>,
+        D<Id("a5"), Num<3>>,
+        Mov<Reg<0>, Num<3>>,
+        Label<Id("loop")>,
+        Add<Mem<Lea<Id("arr")>>, Mem<Lea<Id("arr")>, Reg<0>, 2, -1>>,
+        Dec<Reg<0>>,
+        Jz<Id("end")>,
+        Jmp<Id("loop")>,
+        Label<Id("end")>>;
+
+// Automat stanów: wybór stanu przez JmpTable, wyjście skokiem pod adres
+// etykiety zapisany w pamięci.
+using tmpasm_dispatch = Program<
+        D<Id("state"), Num<0>>,
+        D<Id("trace"), Num<0>>,
+        D<Id("next"), LabelAddr<Id("halt")>>,
+        Label<Id("loop")>,
+        JmpTable<Mem<Lea<Id("state")>>, Id("s0"), Id("s1"), Id("s2")>,
+        Label<Id("s0")>,
+        Add<Mem<Lea<Id("trace")>>, Num<1>>,
+        Mov<Mem<Lea<Id("state")>>, Num<2>>,
+        Jmp<Id("loop")>,
+        Label<Id("s1")>,
+        Add<Mem<Lea<Id("trace")>>, Num<10>>,
+        JmpInd<Mem<Lea<Id("next")>>>,
+        Label<Id("s2")>,
+        Add<Mem<Lea<Id("trace")>>, Num<100>>,
+        Mov<Mem<Lea<Id("state")>>, Num<1>>,
+        Mov<Reg<0>, LabelAddr<Id("loop")>>,
+        JmpInd<Reg<0>>,
+        Label<Id("halt")>,
+        Mov<Mem<Lea<Id("state")>>, Num<3>>>;
+
+// Flagi przeniesienia i nadmiaru dla słowa int8_t: 100 + 100 daje nadmiar
+// bez przeniesienia, a -56 jest mniejsze od 3 ze znakiem i większe bez znaku.
+using tmpasm_conditions = Program<
+        D<Id("a"), Num<100>>,
+        D<Id("max"), Num<-5>>,
+        D<Id("flags"), Num<0>>,
+        Add<Mem<Lea<Id("a")>>, Num<100>>,
+        Jno<Id("x1")>,
+        Inc<Mem<Lea<Id("flags")>>>,
+        Label<Id("x1")>,
+        Jc<Id("x2")>,
+        Inc<Mem<Lea<Id("flags")>>>,
+        Label<Id("x2")>,
+        Cmp<Mem<Lea<Id("a")>>, Num<3>>,
+        CMov<Cc::L, Mem<Lea<Id("max")>>, Num<3>>,
+        CMov<Cc::G, Mem<Lea<Id("max")>>, Mem<Lea<Id("a")>>>,
+        Ja<Id("x3")>,
+        Add<Mem<Lea<Id("flags")>>, Num<100>>,
+        Label<Id("x3")>,
+        Jg<Id("x4")>,
+        Add<Mem<Lea<Id("flags")>>, Num<10>>,
+        Label<Id("x4")>>;
+
+// Czy po Op zachodzi warunek cc. SF jest jak przed wprowadzeniem CF i OF:
+// wynik ujemny jako T, a po Cmp -- a < b.
+template <Cc cc, typename Op>
+using tmpasm_holds = Program<
+        D<Id("a"), Num<0>>,
+        D<Id("holds"), Num<0>>,
+        Op,
+        Jcc<cc, Id("yes")>,
+        Jmp<Id("end")>,
+        Label<Id("yes")>,
+        Inc<Mem<Lea<Id("holds")>>>,
+        Label<Id("end")>>;
+
+template <typename T, Cc cc, typename Op>
+constexpr bool holds() {
+    return Computer<2, T>::template boot<tmpasm_holds<cc, Op>>()[1] == 1;
+}
+
+// Pamięć większa niż zakres słowa: 260 zmiennych, zapis pod ostatnią przez
+// Lea i pod komórkę 300 przez Num. Adresy nie są obcinane do typu słowa.
+template <typename Declarations>
+struct WideMemory;
+
+template <size_t... i>
+struct WideMemory<std::index_sequence<i...>> {
+    using type = Program<
+            D<1000 + i, Num<0>>...,
+            Mov<Mem<Lea<1000 + sizeof...(i) - 1>>, Num<7>>,
+            Mov<Mem<Num<300>>, Num<8>>>;
+};
+
+using tmpasm_wide_memory = WideMemory<std::make_index_sequence<260>>::type;
+
+// Dodawanie i odejmowanie liczb 256-bitowych, po jednej instrukcji na słowo.
+// Inc i Dec nie zmieniają CF, więc przeniesienie przechodzi przez pętlę.
+template <template <typename, typename> class Op, uint64_t a0, uint64_t a1>
+using tmpasm_bignum = Program<
+        D<Id("a"), Num<a0>>,
+        D<Id("a1"), Num<a1>>,
+        D<Id("a2"), Num<uint64_t(5)>>,
+        D<Id("a3"), Num<uint64_t(0)>>,
+        D<Id("b"), Num<uint64_t(1)>>,
+        D<Id("b1"), Num<uint64_t(0)>>,
+        D<Id("b2"), Num<uint64_t(0)>>,
+        D<Id("b3"), Num<uint64_t(0)>>,
+        Mov<Reg<0>, Num<0>>,
+        Mov<Reg<1>, Num<4>>,
+        Cmp<Reg<0>, Reg<0>>,
+        Label<Id("loop")>,
+        Op<Mem<Lea<Id("a")>, Reg<0>>, Mem<Lea<Id("b")>, Reg<0>>>,
+        Inc<Reg<0>>,
+        Dec<Reg<1>>,
+        Jnz<Id("loop")>>;
+
+#ifdef __SIZEOF_INT128__
+using tmpasm_int128 = Program<
+        D<Id("a"), Num<static_cast<__int128>(1) << 100>>,
+        D<Id("b"), Num<0>>,
+        Sub<Mem<Lea<Id("b")>>, Mem<Lea<Id("a")>>>,
+        CMov<Cc::S, Mem<Lea<Id("a")>>, Num<1>>>;
+#endif
+
 int main() {
     static_assert(compare(
             Computer<1, int8_t>::boot<tmpasm_move>(),
@@ -178,5 +414,104 @@ int main() {
             std::array<int, 4>({0,10,50,0})),
                   "Failed [tmpasm_multiplication].");
 
+    // bloki podstawowe
+    static_assert(BasicBlocks<tmpasm_multiplication::Instructions>::layout.count == 4,
+                  "Failed [tmpasm_multiplication blocks].");
+
+    // rejestry
+    static_assert(compare(
+            Computer<2, int>::boot<tmpasm_registers>(),
+            std::array<int, 2>({0, 55})),
+                  "Failed [tmpasm_registers].");
+
+    static_assert(Computer<6, int>::boot<tmpasm_indexed>()[0] == 6,
+                  "Failed [tmpasm_indexed].");
+
+    // flagi i warunki
+    static_assert(compare(
+            Computer<3, int8_t>::boot<tmpasm_conditions>(),
+            std::array<int8_t, 3>({-56, 3, 12})),
+                  "Failed [tmpasm_conditions].");
+
+    static_assert(holds<int8_t, Cc::S, Cmp<Num<-100>, Num<100>>>(),
+                  "Failed [tmpasm_holds<Js, Cmp int8_t>].");
+    static_assert(holds<int8_t, Cc::L, Cmp<Num<-100>, Num<100>>>(),
+                  "Failed [tmpasm_holds<Jl, Cmp int8_t>].");
+    static_assert(holds<uint8_t, Cc::S, Cmp<Num<0>, Num<200>>>(),
+                  "Failed [tmpasm_holds<Js, Cmp uint8_t>].");
+    static_assert(holds<uint8_t, Cc::B, Cmp<Num<0>, Num<200>>>(),
+                  "Failed [tmpasm_holds<Jb, Cmp uint8_t>].");
+    // ZF i SF po Cmp porównują argumenty przed obcięciem do słowa.
+    static_assert(Computer<4, uint8_t>::boot<
+                          tmpasm_holds<Cc::S, Cmp<Num<-100>, Num<100>>>>()[1] == 1,
+                  "Failed [tmpasm_holds<Js, Cmp<-100, 100> uint8_t>].");
+    static_assert(Computer<4, uint8_t>::boot<
+                          tmpasm_holds<Cc::E, Cmp<Num<256>, Num<0>>>>()[1] == 0,
+                  "Failed [tmpasm_holds<Jz, Cmp<256, 0> uint8_t>].");
+    static_assert(!holds<uint8_t, Cc::S, Add<Mem<Lea<Id("a")>>, Num<200>>>(),
+                  "Failed [tmpasm_holds<Js, Add uint8_t>].");
+    static_assert(holds<int8_t, Cc::S, Add<Mem<Lea<Id("a")>>, Num<-56>>>(),
+                  "Failed [tmpasm_holds<Js, Add int8_t>].");
+
+    // adresy szersze niż słowo
+    static_assert(Computer<301, uint8_t>::boot<tmpasm_wide_memory>()[259] == 7 &&
+                  Computer<301, uint8_t>::boot<tmpasm_wide_memory>()[300] == 8 &&
+                  Computer<301, uint8_t>::boot<tmpasm_wide_memory>()[3] == 0 &&
+                  Computer<301, uint8_t>::boot<tmpasm_wide_memory>()[44] == 0,
+                  "Failed [tmpasm_wide_memory].");
+
+    // arytmetyka wielosłowowa
+    static_assert(compare(
+            Computer<8, uint64_t>::boot<tmpasm_bignum<Adc, ~0ull, ~0ull>>(),
+            std::array<uint64_t, 8>({0, 0, 6, 0, 1, 0, 0, 0})),
+                  "Failed [tmpasm_bignum<Adc>].");
+
+    static_assert(compare(
+            Computer<8, uint64_t>::boot<tmpasm_bignum<Sbb, 0, 0>>(),
+            std::array<uint64_t, 8>({~0ull, ~0ull, 4, 0, 1, 0, 0, 0})),
+                  "Failed [tmpasm_bignum<Sbb>].");
+
+#ifdef __SIZEOF_INT128__
+    static_assert(Computer<2, __int128>::boot<tmpasm_int128>()[1] ==
+                          -(static_cast<__int128>(1) << 100),
+                  "Failed [tmpasm_int128].");
+    static_assert(Computer<2, __int128>::boot<tmpasm_int128>()[0] == 1,
+                  "Failed [tmpasm_int128].");
+#endif
+
+    // skoki pośrednie
+    static_assert(compare(
+            Computer<3, int>::boot<tmpasm_dispatch>(),
+            std::array<int, 3>({3, 111, 17})),
+                  "Failed [tmpasm_dispatch].");
+
+    // porty
+    static_assert(compare(run_double().output, std::array<int, 3>({2, 4, 6})),
+                  "Failed [tmpasm_double].");
+
+    // podprogramy
+    static_assert(compare(
+            Computer<4, int>::boot<tmpasm_call>(),
+            std::array<int, 4>({3, 6, 0, 0})),
+                  "Failed [tmpasm_call].");
+
+    static_assert(compare(
+            Computer<4, int>::boot<tmpasm_stack>(),
+            std::array<int, 4>({7, 5, 0, 0})),
+                  "Failed [tmpasm_stack].");
+
+    static_assert(Computer<16, int>::boot<tmpasm_factorial>()[1] == 120,
+                  "Failed [tmpasm_factorial].");
+
+    static_assert(compare(
+            Computer<2, int>::boot<tmpasm_long_loop>(),
+            std::array<int, 2>({0, 2000})),
+                  "Failed [tmpasm_long_loop].");
+
+    static_assert(compare(
+            Computer<4, int>::boot<tmpasm_linked>(),
+            std::array<int, 4>({0, 30, 10, 0})),
+                  "Failed [tmpasm_linked].");
+
 }
 